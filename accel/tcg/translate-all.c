@@ -322,22 +322,64 @@ static int encode_search(TranslationBlock *tb, uint8_t *block)
     return p - block;
 }
 
-/* The cpu state corresponding to 'searched_pc' is restored.
- * When reset_icount is true, current TB will be interrupted and
- * icount should be recalculated.
+/*
+ * Per-thread cache of decoded restore state, indexed by the host return
+ * address of the faulting helper call.  Guests that take many exceptions
+ * from the same call site (e.g. CHERI capability faults used for lazy
+ * revocation) would otherwise pay for a TB lookup and a full sleb128
+ * decode of the search data on every fault.  Host code at a given address
+ * belongs to a single TB until the next tb_flush(), so entries are tagged
+ * with the flush generation and need no other invalidation.  One-shot
+ * (CF_NOCACHE) blocks are freed right after use and are never cached.
  */
-static int cpu_restore_state_from_tb(CPUState *cpu, TranslationBlock *tb,
-                                     uintptr_t searched_pc, bool reset_icount)
+#define TB_RESTORE_CACHE_BITS 6
+#define TB_RESTORE_CACHE_SIZE (1 << TB_RESTORE_CACHE_BITS)
+
+typedef struct TBRestoreCacheEntry {
+    uintptr_t host_pc;
+    unsigned flush_count;
+    int insns_left;
+    TranslationBlock *tb;
+    target_ulong data[TARGET_INSN_START_WORDS];
+} TBRestoreCacheEntry;
+
+static __thread TBRestoreCacheEntry tb_restore_cache[TB_RESTORE_CACHE_SIZE];
+
+static inline TBRestoreCacheEntry *tb_restore_cache_entry(uintptr_t host_pc)
 {
-    target_ulong data[TARGET_INSN_START_WORDS] = { tb->pc };
-    uintptr_t host_pc = (uintptr_t)tb->tc.ptr;
+    return &tb_restore_cache[(host_pc ^ (host_pc >> TB_RESTORE_CACHE_BITS))
+                             & (TB_RESTORE_CACHE_SIZE - 1)];
+}
+
+static bool tb_restore_cache_lookup(CPUState *cpu, uintptr_t host_pc,
+                                    bool reset_icount)
+{
+    TBRestoreCacheEntry *e = tb_restore_cache_entry(host_pc);
     CPUArchState *env = cpu->env_ptr;
+
+    if (e->host_pc != host_pc ||
+        e->flush_count != atomic_read(&tb_ctx.tb_flush_count)) {
+        return false;
+    }
+    if (reset_icount && (tb_cflags(e->tb) & CF_USE_ICOUNT)) {
+        assert(use_icount);
+        cpu->icount_decr.u16.low += e->insns_left;
+    }
+    restore_state_to_opc(env, e->tb, e->data);
+    return true;
+}
+
+/*
+ * Decode the insn start data of the guest instruction of @tb that
+ * contains the host address @searched_pc into @data.  Returns the number
+ * of instructions of @tb from that one on, or -1 if not found.
+ */
+static int cpu_unwind_data_from_tb(TranslationBlock *tb, uintptr_t searched_pc,
+                                   target_ulong *data)
+{
+    uintptr_t host_pc = (uintptr_t)tb->tc.ptr;
     uint8_t *p = tb->tc.ptr + tb->tc.size;
     int i, j, num_insns = tb->icount;
-#ifdef CONFIG_PROFILER
-    TCGProfile *prof = &tcg_ctx->prof;
-    int64_t ti = profile_getclock();
-#endif
 
     searched_pc -= GETPC_ADJ;
 
@@ -345,6 +387,10 @@ static int cpu_restore_state_from_tb(CPUState *cpu, TranslationBlock *tb,
         return -1;
     }
 
+    data[0] = tb->pc;
+    for (j = 1; j < TARGET_INSN_START_WORDS; ++j) {
+        data[j] = 0;
+    }
     /* Reconstruct the stored insn data while looking for the point at
        which the end of the insn exceeds the searched_pc.  */
     for (i = 0; i < num_insns; ++i) {
@@ -353,20 +399,50 @@ static int cpu_restore_state_from_tb(CPUState *cpu, TranslationBlock *tb,
         }
         host_pc += decode_sleb128(&p);
         if (host_pc > searched_pc) {
-            goto found;
+            return num_insns - i;
         }
     }
     return -1;
+}
+
+/* The cpu state corresponding to 'searched_pc' is restored.
+ * When reset_icount is true, current TB will be interrupted and
+ * icount should be recalculated.
+ */
+static int cpu_restore_state_from_tb(CPUState *cpu, TranslationBlock *tb,
+                                     uintptr_t searched_pc, bool reset_icount)
+{
+    target_ulong data[TARGET_INSN_START_WORDS];
+    CPUArchState *env = cpu->env_ptr;
+    int insns_left;
+#ifdef CONFIG_PROFILER
+    TCGProfile *prof = &tcg_ctx->prof;
+    int64_t ti = profile_getclock();
+#endif
+
+    insns_left = cpu_unwind_data_from_tb(tb, searched_pc, data);
+    if (insns_left < 0) {
+        return -1;
+    }
 
- found:
     if (reset_icount && (tb_cflags(tb) & CF_USE_ICOUNT)) {
         assert(use_icount);
         /* Reset the cycle counter to the start of the block
            and shift if to the number of actually executed instructions */
-        cpu->icount_decr.u16.low += num_insns - i;
+        cpu->icount_decr.u16.low += insns_left;
     }
     restore_state_to_opc(env, tb, data);
 
+    if (!(tb_cflags(tb) & CF_NOCACHE)) {
+        TBRestoreCacheEntry *e = tb_restore_cache_entry(searched_pc);
+
+        e->host_pc = searched_pc;
+        e->flush_count = atomic_read(&tb_ctx.tb_flush_count);
+        e->insns_left = insns_left;
+        e->tb = tb;
+        memcpy(e->data, data, sizeof(data));
+    }
+
 #ifdef CONFIG_PROFILER
     atomic_set(&prof->restore_time,
                 prof->restore_time + profile_getclock() - ti);
@@ -397,6 +473,9 @@ bool cpu_restore_state(CPUState *cpu, uintptr_t host_pc, bool will_exit)
     check_offset = host_pc - (uintptr_t) tcg_init_ctx.code_gen_buffer;
 
     if (check_offset < tcg_init_ctx.code_gen_buffer_size) {
+        if (tb_restore_cache_lookup(cpu, host_pc, will_exit)) {
+            return true;
+        }
         tb = tcg_tb_lookup(host_pc);
         if (tb) {
             cpu_restore_state_from_tb(cpu, tb, host_pc, will_exit);
@@ -412,6 +491,25 @@ bool cpu_restore_state(CPUState *cpu, uintptr_t host_pc, bool will_exit)
     return r;
 }
 
+bool cpu_unwind_state_data(CPUState *cpu, uintptr_t host_pc,
+                           target_ulong *data)
+{
+    TBRestoreCacheEntry *e = tb_restore_cache_entry(host_pc);
+    TranslationBlock *tb;
+
+    if (e->host_pc == host_pc &&
+        e->flush_count == atomic_read(&tb_ctx.tb_flush_count)) {
+        memcpy(data, e->data, sizeof(e->data));
+        return true;
+    }
+    if (host_pc - (uintptr_t)tcg_init_ctx.code_gen_buffer >=
+        tcg_init_ctx.code_gen_buffer_size) {
+        return false;
+    }
+    tb = tcg_tb_lookup(host_pc);
+    return tb && cpu_unwind_data_from_tb(tb, host_pc, data) >= 0;
+}
+
 static void page_init(void)
 {
     page_size_init();
@@ -81,6 +81,7 @@ qcow2_co_preadv_compressed(BlockDriverState *bs,
                            uint64_t offset,
                            uint64_t bytes,
                            QEMUIOVector *qiov);
+static int qcow2_max_compress_threads(void);
 
 static int qcow2_probe(const uint8_t *buf, int buf_size, const char *filename)
 {
@@ -1700,6 +1701,7 @@ static int coroutine_fn qcow2_do_open(BlockDriverState *bs, QDict *options,
 #endif
 
     qemu_co_queue_init(&s->compress_wait_queue);
+    s->max_compress_threads = qcow2_max_compress_threads();
 
     return ret;
 
@@ -4001,7 +4003,24 @@ static ssize_t qcow2_decompress(void *dest, size_t dest_size,
     return ret;
 }
 
-#define MAX_COMPRESS_THREADS 4
+/*
+ * Compression is offloaded to the AioContext's thread pool, which is capped
+ * at 64 workers.  Scale the number of concurrent compressions with the host
+ * so that 'qemu-img convert -c -m N' is not bottlenecked on a handful of
+ * threads, but leave some pool workers free for other users.
+ */
+#define MIN_COMPRESS_THREADS 4
+#define MAX_COMPRESS_THREADS 32
+
+static int qcow2_max_compress_threads(void)
+{
+    long host_procs = sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (host_procs <= 0) {
+        return MIN_COMPRESS_THREADS;
+    }
+    return MAX(MIN_COMPRESS_THREADS, MIN(host_procs, MAX_COMPRESS_THREADS));
+}
 
 typedef ssize_t (*Qcow2CompressFunc)(void *dest, size_t dest_size,
                                      const void *src, size_t src_size);
@@ -4045,7 +4064,7 @@ qcow2_co_do_compress(BlockDriverState *bs, void *dest, size_t dest_size,
         .func = func,
     };
 
-    while (s->nb_compress_threads >= MAX_COMPRESS_THREADS) {
+    while (s->nb_compress_threads >= s->max_compress_threads) {
         qemu_co_queue_wait(&s->compress_wait_queue, NULL);
     }
 
@@ -348,6 +348,7 @@ typedef struct BDRVQcow2State {
 
     CoQueue compress_wait_queue;
     int nb_compress_threads;
+    int max_compress_threads;
 
     BdrvChild *data_file;
 } BDRVQcow2State;
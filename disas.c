@@ -420,16 +420,16 @@ static bool cap_disas_monitor(disassemble_info *info, uint64_t pc, int count)
 # define cap_disas_monitor(i, p, c)  false
 #endif /* CONFIG_CAPSTONE */
 
-/* Disassemble this for me please... (debugging).  */
-void target_disas(FILE *out, CPUState *cpu, target_ulong code,
-                  target_ulong size)
+static void target_disas_stream(FILE *out, fprintf_function fprintf_fn,
+                                CPUState *cpu, target_ulong code,
+                                target_ulong size)
 {
     CPUClass *cc = CPU_GET_CLASS(cpu);
     target_ulong pc;
     int count;
     CPUDebug s;
 
-    INIT_DISASSEMBLE_INFO(s.info, out, fprintf);
+    INIT_DISASSEMBLE_INFO(s.info, out, fprintf_fn);
 
     s.cpu = cpu;
     s.info.read_memory_func = target_read_memory;
@@ -460,21 +460,53 @@ void target_disas(FILE *out, CPUState *cpu, target_ulong code,
     }
 
     for (pc = code; size > 0; pc += count, size -= count) {
-	fprintf(out, "0x" TARGET_FMT_lx ":  ", pc);
-	count = s.info.print_insn(pc, &s.info);
-	fprintf(out, "\n");
+        fprintf_fn(out, "0x" TARGET_FMT_lx ":  ", pc);
+        count = s.info.print_insn(pc, &s.info);
+        fprintf_fn(out, "\n");
 	if (count < 0)
 	    break;
         if (size < count) {
-            fprintf(out,
-                    "Disassembler disagrees with translator over instruction "
-                    "decoding\n"
-                    "Please report this to qemu-devel@nongnu.org\n");
+            fprintf_fn(out,
+                       "Disassembler disagrees with translator over instruction "
+                       "decoding\n"
+                       "Please report this to qemu-devel@nongnu.org\n");
             break;
         }
     }
 }
 
+/* Disassemble this for me please... (debugging).  */
+void target_disas(FILE *out, CPUState *cpu, target_ulong code,
+                  target_ulong size)
+{
+    target_disas_stream(out, fprintf, cpu, code, size);
+}
+
+static int GCC_FMT_ATTR(2, 3)
+gstring_fprintf(FILE *stream, const char *fmt, ...)
+{
+    GString *s = (GString *)stream;
+    gsize len = s->len;
+    va_list ap;
+
+    va_start(ap, fmt);
+    g_string_append_vprintf(s, fmt, ap);
+    va_end(ap);
+    return s->len - len;
+}
+
+/*
+ * Same output as target_disas(), but returned as a string that the caller
+ * must g_free().
+ */
+char *target_disas_str(CPUState *cpu, target_ulong code, target_ulong size)
+{
+    GString *s = g_string_new(NULL);
+
+    target_disas_stream((FILE *)s, gstring_fprintf, cpu, code, size);
+    return g_string_free(s, false);
+}
+
 /* Disassemble this for me please... (debugging). */
 void disas(FILE *out, void *code, unsigned long size)
 {
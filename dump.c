@@ -45,12 +45,25 @@
 #endif
 
 #define MAX_GUEST_NOTE_SIZE (1 << 20) /* 1MB should be enough */
+#define DUMP_WRITE_CHUNK (1 << 20)
+
+/* kdump-compressed pages are compressed in batches by a pool of threads */
+#define DUMP_COMPRESS_BATCH       256
+#define DUMP_COMPRESS_THREADS_MAX 8
 
 #define ELF_NOTE_SIZE(hdr_size, name_size, desc_size)   \
     ((DIV_ROUND_UP((hdr_size), 4) +                     \
       DIV_ROUND_UP((name_size), 4) +                    \
       DIV_ROUND_UP((desc_size), 4)) * 4)
 
+#ifdef TARGET_CHERI
+#define CHERI_TAG_NOTE_NAME     "CHERI"
+#define NT_CHERI_TAGS           1
+#define CHERI_TAG_NOTE_VERSION  1
+/* Number of capabilities covered by one record of the tag note */
+#define CHERI_TAG_NOTE_CHUNK    4096
+#endif
+
 uint16_t cpu_to_dump16(DumpState *s, uint16_t val)
 {
     if (s->dump_info.d_endian == ELFDATA2LSB) {
@@ -91,6 +104,8 @@ static int dump_cleanup(DumpState *s)
     close(s->fd);
     g_free(s->guest_note);
     s->guest_note = NULL;
+    g_free(s->cheri_tag_note);
+    s->cheri_tag_note = NULL;
     if (s->resume) {
         if (s->detached) {
             qemu_mutex_lock_iothread();
@@ -267,9 +282,23 @@ static void write_guest_note(WriteCoreDumpFunction f, DumpState *s,
     }
 }
 
+static void write_cheri_tag_note(WriteCoreDumpFunction f, DumpState *s,
+                                 Error **errp)
+{
+    int ret;
+
+    if (s->cheri_tag_note) {
+        ret = f(s->cheri_tag_note, s->cheri_tag_note_size, s);
+        if (ret < 0) {
+            error_setg(errp, "dump: failed to write capability tag note");
+        }
+    }
+}
+
 static void write_elf64_notes(WriteCoreDumpFunction f, DumpState *s,
                               Error **errp)
 {
+    Error *local_err = NULL;
     CPUState *cpu;
     int ret;
     int id;
@@ -291,6 +320,12 @@ static void write_elf64_notes(WriteCoreDumpFunction f, DumpState *s,
         }
     }
 
+    /* the guest note must stay last, see create_header64() */
+    write_cheri_tag_note(f, s, &local_err);
+    if (local_err) {
+        error_propagate(errp, local_err);
+        return;
+    }
     write_guest_note(f, s, errp);
 }
 
@@ -318,6 +353,7 @@ static void write_elf32_note(DumpState *s, Error **errp)
 static void write_elf32_notes(WriteCoreDumpFunction f, DumpState *s,
                               Error **errp)
 {
+    Error *local_err = NULL;
     CPUState *cpu;
     int ret;
     int id;
@@ -339,6 +375,12 @@ static void write_elf32_notes(WriteCoreDumpFunction f, DumpState *s,
         }
     }
 
+    /* the guest note must stay last, see create_header32() */
+    write_cheri_tag_note(f, s, &local_err);
+    if (local_err) {
+        error_propagate(errp, local_err);
+        return;
+    }
     write_guest_note(f, s, errp);
 }
 
@@ -381,25 +423,16 @@ static void write_data(DumpState *s, void *buf, int length, Error **errp)
     }
 }
 
-/* write the memory to vmcore. 1 page per I/O. */
+/* write the memory to vmcore, up to DUMP_WRITE_CHUNK bytes per I/O. */
 static void write_memory(DumpState *s, GuestPhysBlock *block, ram_addr_t start,
                          int64_t size, Error **errp)
 {
-    int64_t i;
+    int64_t offset, len;
     Error *local_err = NULL;
 
-    for (i = 0; i < size / s->dump_info.page_size; i++) {
-        write_data(s, block->host_addr + start + i * s->dump_info.page_size,
-                   s->dump_info.page_size, &local_err);
-        if (local_err) {
-            error_propagate(errp, local_err);
-            return;
-        }
-    }
-
-    if ((size % s->dump_info.page_size) != 0) {
-        write_data(s, block->host_addr + start + i * s->dump_info.page_size,
-                   size % s->dump_info.page_size, &local_err);
+    for (offset = 0; offset < size; offset += len) {
+        len = MIN(size - offset, DUMP_WRITE_CHUNK);
+        write_data(s, block->host_addr + start + offset, len, &local_err);
         if (local_err) {
             error_propagate(errp, local_err);
             return;
@@ -1299,20 +1332,191 @@ static inline bool is_zero_page(const uint8_t *buf, size_t page_size)
     return buffer_is_zero(buf, page_size);
 }
 
+typedef struct DumpCompressPool DumpCompressPool;
+
+typedef struct DumpCompressJob {
+    uint8_t *buf;               /* page to compress, in guest RAM */
+    uint8_t *buf_out;           /* compressed data */
+    size_t size_out;
+    uint32_t flags;             /* DUMP_DH_COMPRESSED_*, 0 if stored plain */
+    bool zero;
+} DumpCompressJob;
+
+typedef struct DumpCompressWorker {
+    DumpCompressPool *pool;
+    int index;
+    QemuThread thread;
+    QemuSemaphore go;
+    QemuSemaphore done;
+    bool quit;
+#ifdef CONFIG_LZO
+    lzo_bytep wrkmem;
+#endif
+} DumpCompressWorker;
+
+struct DumpCompressPool {
+    DumpState *s;
+    size_t len_buf_out;
+    DumpCompressJob jobs[DUMP_COMPRESS_BATCH];
+    int njobs;
+    /* worker 0 is the dumping thread itself */
+    int nworkers;
+    DumpCompressWorker workers[DUMP_COMPRESS_THREADS_MAX];
+};
+
+/*
+ * compress a single page with the configured format. Only one compression
+ * format is set in s->flag_compress, and when compression fails to work
+ * (or does not make the page smaller) we fall back to save in plaintext.
+ */
+static void dump_compress_page(DumpCompressWorker *w, DumpCompressJob *job)
+{
+    DumpState *s = w->pool->s;
+    size_t page_size = s->dump_info.page_size;
+
+    job->zero = is_zero_page(job->buf, page_size);
+    if (job->zero) {
+        return;
+    }
+
+    job->size_out = w->pool->len_buf_out;
+    if ((s->flag_compress & DUMP_DH_COMPRESSED_ZLIB) &&
+        (compress2(job->buf_out, (uLongf *)&job->size_out, job->buf,
+                   page_size, Z_BEST_SPEED) == Z_OK) &&
+        (job->size_out < page_size)) {
+        job->flags = DUMP_DH_COMPRESSED_ZLIB;
+        return;
+    }
+#ifdef CONFIG_LZO
+    if ((s->flag_compress & DUMP_DH_COMPRESSED_LZO) &&
+        (lzo1x_1_compress(job->buf, page_size, job->buf_out,
+                          (lzo_uint *)&job->size_out, w->wrkmem) == LZO_E_OK) &&
+        (job->size_out < page_size)) {
+        job->flags = DUMP_DH_COMPRESSED_LZO;
+        return;
+    }
+#endif
+#ifdef CONFIG_SNAPPY
+    if ((s->flag_compress & DUMP_DH_COMPRESSED_SNAPPY) &&
+        (snappy_compress((char *)job->buf, page_size,
+                         (char *)job->buf_out, &job->size_out) == SNAPPY_OK) &&
+        (job->size_out < page_size)) {
+        job->flags = DUMP_DH_COMPRESSED_SNAPPY;
+        return;
+    }
+#endif
+    job->flags = 0;
+    job->size_out = page_size;
+}
+
+static void dump_compress_jobs(DumpCompressWorker *w)
+{
+    DumpCompressPool *pool = w->pool;
+    int i;
+
+    for (i = w->index; i < pool->njobs; i += pool->nworkers) {
+        dump_compress_page(w, &pool->jobs[i]);
+    }
+}
+
+static void *dump_compress_thread(void *opaque)
+{
+    DumpCompressWorker *w = opaque;
+
+    for (;;) {
+        qemu_sem_wait(&w->go);
+        if (w->quit) {
+            break;
+        }
+        dump_compress_jobs(w);
+        qemu_sem_post(&w->done);
+    }
+    return NULL;
+}
+
+static DumpCompressPool *dump_compress_pool_new(DumpState *s,
+                                                size_t len_buf_out)
+{
+    DumpCompressPool *pool = g_new0(DumpCompressPool, 1);
+    long nprocs = sysconf(_SC_NPROCESSORS_ONLN);
+    int i;
+
+    pool->s = s;
+    pool->len_buf_out = len_buf_out;
+    /* the VM is stopped while dumping, so use every host CPU we have */
+    pool->nworkers = MAX(1, MIN(nprocs, DUMP_COMPRESS_THREADS_MAX));
+
+    for (i = 0; i < DUMP_COMPRESS_BATCH; i++) {
+        pool->jobs[i].buf_out = g_malloc(len_buf_out);
+    }
+    for (i = 0; i < pool->nworkers; i++) {
+        DumpCompressWorker *w = &pool->workers[i];
+
+        w->pool = pool;
+        w->index = i;
+#ifdef CONFIG_LZO
+        w->wrkmem = g_malloc(LZO1X_1_MEM_COMPRESS);
+#endif
+        if (i > 0) {
+            qemu_sem_init(&w->go, 0);
+            qemu_sem_init(&w->done, 0);
+            qemu_thread_create(&w->thread, "dump_compress",
+                               dump_compress_thread, w, QEMU_THREAD_JOINABLE);
+        }
+    }
+    return pool;
+}
+
+static void dump_compress_pool_run(DumpCompressPool *pool)
+{
+    int i;
+
+    for (i = 1; i < pool->nworkers; i++) {
+        qemu_sem_post(&pool->workers[i].go);
+    }
+    dump_compress_jobs(&pool->workers[0]);
+    for (i = 1; i < pool->nworkers; i++) {
+        qemu_sem_wait(&pool->workers[i].done);
+    }
+}
+
+static void dump_compress_pool_free(DumpCompressPool *pool)
+{
+    int i;
+
+    for (i = 0; i < pool->nworkers; i++) {
+        DumpCompressWorker *w = &pool->workers[i];
+
+        if (i > 0) {
+            w->quit = true;
+            qemu_sem_post(&w->go);
+            qemu_thread_join(&w->thread);
+            qemu_sem_destroy(&w->go);
+            qemu_sem_destroy(&w->done);
+        }
+#ifdef CONFIG_LZO
+        g_free(w->wrkmem);
+#endif
+    }
+    for (i = 0; i < DUMP_COMPRESS_BATCH; i++) {
+        g_free(pool->jobs[i].buf_out);
+    }
+    g_free(pool);
+}
+
 static void write_dump_pages(DumpState *s, Error **errp)
 {
     int ret = 0;
     DataCache page_desc, page_data;
-    size_t len_buf_out, size_out;
-#ifdef CONFIG_LZO
-    lzo_bytep wrkmem = NULL;
-#endif
-    uint8_t *buf_out = NULL;
+    size_t len_buf_out;
+    DumpCompressPool *pool;
     off_t offset_desc, offset_data;
     PageDescriptor pd, pd_zero;
     uint8_t *buf;
     GuestPhysBlock *block_iter = NULL;
     uint64_t pfn_iter;
+    bool more = true;
+    int i;
 
     /* get offset of page_desc and page_data in dump file */
     offset_desc = s->offset_page;
@@ -1321,15 +1525,11 @@ static void write_dump_pages(DumpState *s, Error **errp)
     prepare_data_cache(&page_desc, s, offset_desc);
     prepare_data_cache(&page_data, s, offset_data);
 
-    /* prepare buffer to store compressed data */
+    /* prepare buffers to store compressed data */
     len_buf_out = get_len_buf_out(s->dump_info.page_size, s->flag_compress);
     assert(len_buf_out != 0);
 
-#ifdef CONFIG_LZO
-    wrkmem = g_malloc(LZO1X_1_MEM_COMPRESS);
-#endif
-
-    buf_out = g_malloc(len_buf_out);
+    pool = dump_compress_pool_new(s, len_buf_out);
 
     /*
      * init zero page's page_desc and page_data, because every zero page
@@ -1350,100 +1550,54 @@ static void write_dump_pages(DumpState *s, Error **errp)
     offset_data += s->dump_info.page_size;
 
     /*
-     * dump memory to vmcore page by page. zero page will all be resided in the
-     * first page of page section
+     * dump memory to vmcore in batches of pages: the pages of a batch are
+     * checked for zero and compressed in parallel, then written out in
+     * order. zero page will all be resided in the first page of page
+     * section
      */
-    while (get_next_page(&block_iter, &pfn_iter, &buf, s)) {
-        /* check zero page */
-        if (is_zero_page(buf, s->dump_info.page_size)) {
-            ret = write_cache(&page_desc, &pd_zero, sizeof(PageDescriptor),
-                              false);
-            if (ret < 0) {
-                error_setg(errp, "dump: failed to write page desc");
-                goto out;
-            }
-        } else {
-            /*
-             * not zero page, then:
-             * 1. compress the page
-             * 2. write the compressed page into the cache of page_data
-             * 3. get page desc of the compressed page and write it into the
-             *    cache of page_desc
-             *
-             * only one compression format will be used here, for
-             * s->flag_compress is set. But when compression fails to work,
-             * we fall back to save in plaintext.
-             */
-             size_out = len_buf_out;
-             if ((s->flag_compress & DUMP_DH_COMPRESSED_ZLIB) &&
-                    (compress2(buf_out, (uLongf *)&size_out, buf,
-                               s->dump_info.page_size, Z_BEST_SPEED) == Z_OK) &&
-                    (size_out < s->dump_info.page_size)) {
-                pd.flags = cpu_to_dump32(s, DUMP_DH_COMPRESSED_ZLIB);
-                pd.size  = cpu_to_dump32(s, size_out);
-
-                ret = write_cache(&page_data, buf_out, size_out, false);
-                if (ret < 0) {
-                    error_setg(errp, "dump: failed to write page data");
-                    goto out;
-                }
-#ifdef CONFIG_LZO
-            } else if ((s->flag_compress & DUMP_DH_COMPRESSED_LZO) &&
-                    (lzo1x_1_compress(buf, s->dump_info.page_size, buf_out,
-                    (lzo_uint *)&size_out, wrkmem) == LZO_E_OK) &&
-                    (size_out < s->dump_info.page_size)) {
-                pd.flags = cpu_to_dump32(s, DUMP_DH_COMPRESSED_LZO);
-                pd.size  = cpu_to_dump32(s, size_out);
-
-                ret = write_cache(&page_data, buf_out, size_out, false);
-                if (ret < 0) {
-                    error_setg(errp, "dump: failed to write page data");
-                    goto out;
-                }
-#endif
-#ifdef CONFIG_SNAPPY
-            } else if ((s->flag_compress & DUMP_DH_COMPRESSED_SNAPPY) &&
-                    (snappy_compress((char *)buf, s->dump_info.page_size,
-                    (char *)buf_out, &size_out) == SNAPPY_OK) &&
-                    (size_out < s->dump_info.page_size)) {
-                pd.flags = cpu_to_dump32(s, DUMP_DH_COMPRESSED_SNAPPY);
-                pd.size  = cpu_to_dump32(s, size_out);
-
-                ret = write_cache(&page_data, buf_out, size_out, false);
-                if (ret < 0) {
-                    error_setg(errp, "dump: failed to write page data");
-                    goto out;
-                }
-#endif
-            } else {
-                /*
-                 * fall back to save in plaintext, size_out should be
-                 * assigned the target's page size
-                 */
-                pd.flags = cpu_to_dump32(s, 0);
-                size_out = s->dump_info.page_size;
-                pd.size = cpu_to_dump32(s, size_out);
-
-                ret = write_cache(&page_data, buf,
-                                  s->dump_info.page_size, false);
+    while (more) {
+        pool->njobs = 0;
+        while (pool->njobs < DUMP_COMPRESS_BATCH &&
+               (more = get_next_page(&block_iter, &pfn_iter, &buf, s))) {
+            pool->jobs[pool->njobs++].buf = buf;
+        }
+        dump_compress_pool_run(pool);
+
+        for (i = 0; i < pool->njobs; i++) {
+            DumpCompressJob *job = &pool->jobs[i];
+
+            if (job->zero) {
+                ret = write_cache(&page_desc, &pd_zero, sizeof(PageDescriptor),
+                                  false);
                 if (ret < 0) {
-                    error_setg(errp, "dump: failed to write page data");
+                    error_setg(errp, "dump: failed to write page desc");
                     goto out;
                 }
+                s->written_size += s->dump_info.page_size;
+                continue;
+            }
+
+            pd.flags = cpu_to_dump32(s, job->flags);
+            pd.size = cpu_to_dump32(s, job->size_out);
+            ret = write_cache(&page_data, job->flags ? job->buf_out : job->buf,
+                              job->size_out, false);
+            if (ret < 0) {
+                error_setg(errp, "dump: failed to write page data");
+                goto out;
             }
 
             /* get and write page desc here */
             pd.page_flags = cpu_to_dump64(s, 0);
             pd.offset = cpu_to_dump64(s, offset_data);
-            offset_data += size_out;
+            offset_data += job->size_out;
 
             ret = write_cache(&page_desc, &pd, sizeof(PageDescriptor), false);
             if (ret < 0) {
                 error_setg(errp, "dump: failed to write page desc");
                 goto out;
             }
+            s->written_size += s->dump_info.page_size;
         }
-        s->written_size += s->dump_info.page_size;
     }
 
     ret = write_cache(&page_desc, NULL, 0, true);
@@ -1460,12 +1614,7 @@ static void write_dump_pages(DumpState *s, Error **errp)
 out:
     free_data_cache(&page_desc);
     free_data_cache(&page_data);
-
-#ifdef CONFIG_LZO
-    g_free(wrkmem);
-#endif
-
-    g_free(buf_out);
+    dump_compress_pool_free(pool);
 }
 
 static void create_kdump_vmcore(DumpState *s, Error **errp)
@@ -1641,6 +1790,105 @@ static void vmcoreinfo_update_phys_base(DumpState *s)
     g_strfreev(lines);
 }
 
+#ifdef TARGET_CHERI
+/*
+ * Build an ELF note with the capability tags of all guest RAM so that
+ * post-mortem tools can recover provenance.  The descriptor is
+ *
+ *   u32 version, u32 log2(capability size), u64 number of records
+ *
+ * followed by one record per CHERI_TAG_NOTE_CHUNK capabilities that have
+ * at least one tag set:
+ *
+ *   u64 guest physical address, u64 number of capabilities,
+ *   tag bitmap (LSB first) padded to 8 bytes
+ *
+ * Only memory selected by the dump's begin/length filter is described.
+ * Ranges whose tag blocks were never allocated are skipped without being
+ * scanned, so the note stays small for mostly untagged memory.
+ */
+static void dump_cheri_tag_note_init(DumpState *s)
+{
+    size_t head_size = s->dump_info.d_class == ELFCLASS32 ?
+        sizeof(Elf32_Nhdr) : sizeof(Elf64_Nhdr);
+    size_t name_size = sizeof(CHERI_TAG_NOTE_NAME);
+    unsigned shift = cheri_tag_granule_shift();
+    hwaddr chunk = (hwaddr)CHERI_TAG_NOTE_CHUNK << shift;
+    uint8_t bitmap[CHERI_TAG_NOTE_CHUNK / 8];
+    uint64_t nr_records = 0;
+    GuestPhysBlock *block;
+    GByteArray *desc;
+    Elf64_Nhdr *hdr;
+    uint32_t val32;
+    uint64_t val64;
+    uint8_t *note;
+    size_t size;
+
+    desc = g_byte_array_new();
+    val32 = cpu_to_dump32(s, CHERI_TAG_NOTE_VERSION);
+    g_byte_array_append(desc, (uint8_t *)&val32, sizeof(val32));
+    val32 = cpu_to_dump32(s, shift);
+    g_byte_array_append(desc, (uint8_t *)&val32, sizeof(val32));
+    /* number of records, filled in below */
+    val64 = 0;
+    g_byte_array_append(desc, (uint8_t *)&val64, sizeof(val64));
+
+    QTAILQ_FOREACH(block, &s->guest_phys_blocks.head, next) {
+        ram_addr_t ram_addr = qemu_ram_addr_from_host(block->host_addr);
+        hwaddr left = block->target_start, right = block->target_end;
+        hwaddr offset, end;
+
+        if (ram_addr == RAM_ADDR_INVALID) {
+            continue;
+        }
+        if (s->has_filter) {
+            /* only describe the part of the block that is dumped */
+            left = MAX(s->begin, left);
+            right = MIN(s->begin + s->length, right);
+            if (left >= right) {
+                continue;
+            }
+            left = QEMU_ALIGN_DOWN(left, (hwaddr)1 << shift);
+        }
+        end = right - block->target_start;
+        for (offset = left - block->target_start; offset < end;
+             offset += chunk) {
+            hwaddr len = MIN(chunk, end - offset);
+            uint64_t ncaps = len >> shift;
+            size_t bytes = DIV_ROUND_UP(ncaps, 8);
+            uint64_t rec[2];
+
+            if (!cheri_tag_phys_get_bitmap(ram_addr + offset, len, bitmap)) {
+                continue;
+            }
+            memset(bitmap + bytes, 0, ROUND_UP(bytes, 8) - bytes);
+            rec[0] = cpu_to_dump64(s, block->target_start + offset);
+            rec[1] = cpu_to_dump64(s, ncaps);
+            g_byte_array_append(desc, (uint8_t *)rec, sizeof(rec));
+            g_byte_array_append(desc, bitmap, ROUND_UP(bytes, 8));
+            nr_records++;
+        }
+    }
+    val64 = cpu_to_dump64(s, nr_records);
+    memcpy(desc->data + 2 * sizeof(val32), &val64, sizeof(val64));
+
+    /* Elf32_Nhdr and Elf64_Nhdr have the same layout */
+    size = ELF_NOTE_SIZE(head_size, name_size, desc->len);
+    note = g_malloc0(size);
+    hdr = (Elf64_Nhdr *)note;
+    hdr->n_namesz = cpu_to_dump32(s, name_size);
+    hdr->n_descsz = cpu_to_dump32(s, desc->len);
+    hdr->n_type = cpu_to_dump32(s, NT_CHERI_TAGS);
+    memcpy(note + head_size, CHERI_TAG_NOTE_NAME, name_size);
+    memcpy(note + head_size + ROUND_UP(name_size, 4), desc->data, desc->len);
+    g_byte_array_free(desc, true);
+
+    s->cheri_tag_note = note;
+    s->cheri_tag_note_size = size;
+    s->note_size += size;
+}
+#endif
+
 static void dump_init(DumpState *s, int fd, bool has_format,
                       DumpGuestMemoryFormat format, bool paging, bool has_filter,
                       int64_t begin, int64_t length, Error **errp)
@@ -1765,6 +2013,10 @@ static void dump_init(DumpState *s, int fd, bool has_format,
         }
     }
 
+#ifdef TARGET_CHERI
+    dump_cheri_tag_note_init(s);
+#endif
+
     /* get memory mapping */
     if (paging) {
         qemu_get_guest_memory_mapping(&s->list, &s->guest_phys_blocks, &err);
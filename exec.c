@@ -172,6 +172,10 @@ typedef struct PhysPageMap {
 
 struct AddressSpaceDispatch {
     MemoryRegionSection *mru_section;
+    /* Unique for the lifetime of the process; keys the per-thread
+     * section cache so that a recycled dispatch pointer never matches.
+     */
+    uint64_t gen;
     /* This is a multi-level map on the physical address space.
      * The bottom level has pointers to MemoryRegionSections.
      */
@@ -383,18 +387,73 @@ static MemoryRegionSection *phys_page_find(AddressSpaceDispatch *d, hwaddr addr)
     }
 }
 
+/* Per-thread cache of the last few sections looked up, in front of the
+ * shared mru_section.  Threads that alternate between a handful of
+ * regions (e.g. a vCPU touching RAM and tag memory, or a DMA loop
+ * bouncing between guest RAM and a device BAR) otherwise keep evicting
+ * each other's MRU entry and fall back to the radix tree walk.
+ *
+ * Entries are keyed by the dispatch generation.  A section pointer is
+ * only dereferenced when the generation matches that of the dispatch the
+ * caller holds under RCU, so stale entries from a freed FlatView are
+ * never touched.
+ */
+#define SECTION_CACHE_SIZE 4
+
+typedef struct SectionCacheEntry {
+    uint64_t gen;
+    MemoryRegionSection *section;
+} SectionCacheEntry;
+
+static __thread SectionCacheEntry section_cache[SECTION_CACHE_SIZE];
+static __thread unsigned section_cache_next;
+static uint64_t dispatch_gen;
+
+static inline MemoryRegionSection *
+section_cache_lookup(AddressSpaceDispatch *d, hwaddr addr)
+{
+    int i;
+
+    for (i = 0; i < SECTION_CACHE_SIZE; i++) {
+        SectionCacheEntry *e = &section_cache[i];
+
+        if (e->gen == d->gen && section_covers_addr(e->section, addr)) {
+            return e->section;
+        }
+    }
+    return NULL;
+}
+
+static inline void section_cache_insert(AddressSpaceDispatch *d,
+                                        MemoryRegionSection *section)
+{
+    SectionCacheEntry *e;
+
+    if (section == &d->map.sections[PHYS_SECTION_UNASSIGNED]) {
+        return;
+    }
+    e = &section_cache[section_cache_next++ % SECTION_CACHE_SIZE];
+    e->gen = d->gen;
+    e->section = section;
+}
+
 /* Called from RCU critical section */
 static MemoryRegionSection *address_space_lookup_region(AddressSpaceDispatch *d,
                                                         hwaddr addr,
                                                         bool resolve_subpage)
 {
-    MemoryRegionSection *section = atomic_read(&d->mru_section);
+    MemoryRegionSection *section = section_cache_lookup(d, addr);
     subpage_t *subpage;
 
-    if (!section || section == &d->map.sections[PHYS_SECTION_UNASSIGNED] ||
-        !section_covers_addr(section, addr)) {
-        section = phys_page_find(d, addr);
-        atomic_set(&d->mru_section, section);
+    if (!section) {
+        section = atomic_read(&d->mru_section);
+        if (!section ||
+            section == &d->map.sections[PHYS_SECTION_UNASSIGNED] ||
+            !section_covers_addr(section, addr)) {
+            section = phys_page_find(d, addr);
+            atomic_set(&d->mru_section, section);
+        }
+        section_cache_insert(d, section);
     }
     if (resolve_subpage && section->mr->subpage) {
         subpage = container_of(section->mr, subpage_t, iomem);
@@ -1434,7 +1493,26 @@ DirtyBitmapSnapshot *cpu_physical_memory_snapshot_and_clear_dirty
     rcu_read_unlock();
 
     if (tcg_enabled()) {
-        tlb_reset_dirty_range_all(start, length);
+        /*
+         * Only pages written since the last snapshot can have lost their
+         * TLB_NOTDIRTY marking, so re-arm just the span between the first
+         * and last dirty page.  Each re-arm walks every TLB entry of every
+         * CPU, and an idle framebuffer then costs nothing.
+         */
+        unsigned long lo = (start - first) >> TARGET_PAGE_BITS;
+        unsigned long hi = TARGET_PAGE_ALIGN(start + length - first)
+                           >> TARGET_PAGE_BITS;
+        unsigned long dirty_lo = find_next_bit(snap->dirty, hi, lo);
+
+        if (dirty_lo < hi) {
+            unsigned long dirty_hi = find_last_bit(snap->dirty, hi) + 1;
+            ram_addr_t reset_start = MAX(start,
+                                         first + (dirty_lo << TARGET_PAGE_BITS));
+            ram_addr_t reset_end = MIN(start + length,
+                                       first + (dirty_hi << TARGET_PAGE_BITS));
+
+            tlb_reset_dirty_range_all(reset_start, reset_end - reset_start);
+        }
     }
 
     return snap;
@@ -3076,6 +3154,10 @@ AddressSpaceDispatch *address_space_dispatch_new(FlatView *fv)
     AddressSpaceDispatch *d = g_new0(AddressSpaceDispatch, 1);
     uint16_t n;
 
+    /* Called with the BQL held.  Generation 0 marks an unused section
+     * cache entry.
+     */
+    d->gen = ++dispatch_gen;
     n = dummy_section(&d->map, fv, &io_mem_unassigned);
     assert(n == PHYS_SECTION_UNASSIGNED);
     n = dummy_section(&d->map, fv, &io_mem_notdirty);
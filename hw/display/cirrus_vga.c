@@ -34,6 +34,7 @@
 #include "hw/pci/pci.h"
 #include "ui/pixel_ops.h"
 #include "hw/loader.h"
+#include "exec/target_page.h"
 #include "cirrus_vga_internal.h"
 
 /*
@@ -631,6 +632,27 @@ static void cirrus_invalidate_region(CirrusVGAState * s, int off_begin,
         off_begin -= bytesperline - 1;
     }
 
+    /*
+     * If the blit does not wrap around video memory and its lines are at
+     * most a page apart, mark its bounding span dirty in one go.  Every
+     * page in the span then holds the start of some line, so the gaps
+     * only cover pages the blit dirties anyway, the display redraws
+     * nothing extra, and we avoid one dirty bitmap update per line.
+     * With a wider pitch the gaps would contain untouched pages.
+     */
+    if (lines > 1 && abs(off_pitch) <= qemu_target_page_size()) {
+        int first = off_begin;
+        int last = off_begin + (lines - 1) * off_pitch;
+        int span_begin = MIN(first, last);
+        int span_end = MAX(first, last) + bytesperline;
+
+        if (span_begin >= 0 && span_end <= s->cirrus_addr_mask + 1) {
+            memory_region_set_dirty(&s->vga.vram, span_begin,
+                                    span_end - span_begin);
+            return;
+        }
+    }
+
     for (y = 0; y < lines; y++) {
         off_cur = off_begin;
         off_cur_end = ((off_cur + bytesperline - 1) & s->cirrus_addr_mask) + 1;
@@ -61,6 +61,21 @@ void cpu_gen_init(void);
  */
 bool cpu_restore_state(CPUState *cpu, uintptr_t searched_pc, bool will_exit);
 
+/**
+ * cpu_unwind_state_data:
+ * @cpu: the vCPU running the translated code
+ * @host_pc: the host PC inside translated code
+ * @data: output buffer of TARGET_INSN_START_WORDS words
+ * @return: true if the insn start data was found, false otherwise
+ *
+ * Like cpu_restore_state(), but only look up the insn start data of the
+ * guest instruction at @host_pc instead of applying it to the CPU state.
+ * Helpers that merely want to report the current guest PC can use this
+ * without disturbing the state of a TB that will continue executing.
+ */
+bool cpu_unwind_state_data(CPUState *cpu, uintptr_t host_pc,
+                           target_ulong *data);
+
 void QEMU_NORETURN cpu_loop_exit_noexc(CPUState *cpu);
 void QEMU_NORETURN cpu_io_recompile(CPUState *cpu, uintptr_t retaddr);
 TranslationBlock *tb_gen_code(CPUState *cpu,
@@ -0,0 +1,40 @@
+/*
+ * JSON Output Visitor
+ *
+ * This work is licensed under the terms of the GNU LGPL, version 2.1 or later.
+ * See the COPYING.LIB file in the top-level directory.
+ *
+ */
+
+#ifndef JSON_OUTPUT_VISITOR_H
+#define JSON_OUTPUT_VISITOR_H
+
+#include "qapi/visitor.h"
+
+typedef struct JsonOutputVisitor JsonOutputVisitor;
+
+/**
+ * Create a JSON output visitor for @result
+ *
+ * A JSON output visitor writes the JSON text for a QAPI object
+ * straight into a QString, without building the QObject that the
+ * QObject output visitor would produce first.  The text is the same
+ * qobject_to_json() would generate for that QObject, except that
+ * struct members appear in visit order.  With @pretty, it is formatted
+ * like qobject_to_json_pretty() output for a value nested @indent
+ * levels deep, so it can be spliced into an enclosing JSON object.
+ *
+ * visit_start_struct() ... visit_end_struct() writes a JSON object,
+ * visit_start_list() ... visit_end_list() a JSON array.  Scalars are
+ * written as by the QObject output visitor; a null 'str' is written
+ * as "".  For type 'any', the QObject is converted to JSON in place.
+ *
+ * Errors are not expected to happen.
+ *
+ * visit_complete() stores the finished QString in *@result; the
+ * caller owns it.  The caller is responsible for freeing the visitor
+ * with visit_free().
+ */
+Visitor *json_output_visitor_new(bool pretty, int indent, QString **result);
+
+#endif
@@ -18,6 +18,13 @@
 
 typedef void (QmpCommandFunc)(QDict *, QObject **, Error **);
 
+/*
+ * Like QmpCommandFunc, but return the command's result as JSON text,
+ * formatted as the value of the response's "return" member (pretty if
+ * the bool argument is true).
+ */
+typedef void (QmpCommandFuncJSON)(QDict *, QString **, bool, Error **);
+
 typedef enum QmpCommandOptions
 {
     QCO_NO_OPTIONS            =  0x0,
@@ -30,6 +37,7 @@ typedef struct QmpCommand
 {
     const char *name;
     QmpCommandFunc *fn;
+    QmpCommandFuncJSON *fn_json; /* optional, bypasses the QObject result */
     QmpCommandOptions options;
     QTAILQ_ENTRY(QmpCommand) node;
     bool enabled;
@@ -39,6 +47,8 @@ typedef QTAILQ_HEAD(QmpCommandList, QmpCommand) QmpCommandList;
 
 void qmp_register_command(QmpCommandList *cmds, const char *name,
                           QmpCommandFunc *fn, QmpCommandOptions options);
+void qmp_register_command_json(QmpCommandList *cmds, const char *name,
+                               QmpCommandFuncJSON *fn_json);
 QmpCommand *qmp_find_command(QmpCommandList *cmds, const char *name);
 void qmp_disable_command(QmpCommandList *cmds, const char *name);
 void qmp_enable_command(QmpCommandList *cmds, const char *name);
@@ -49,6 +59,8 @@ bool qmp_has_success_response(const QmpCommand *cmd);
 QDict *qmp_error_response(Error *err);
 QDict *qmp_dispatch(QmpCommandList *cmds, QObject *request,
                     bool allow_oob);
+QDict *qmp_dispatch_json(QmpCommandList *cmds, QObject *request,
+                         bool allow_oob, bool pretty, QString **json);
 bool qmp_is_oob(const QDict *dict);
 
 typedef void (*qmp_cmd_callback_fn)(QmpCommand *cmd, void *opaque);
@@ -28,4 +28,8 @@ QDict *qdict_from_jsonf_nofail(const char *string, ...)
 QString *qobject_to_json(const QObject *obj);
 QString *qobject_to_json_pretty(const QObject *obj);
 
+void qstring_append_json_str(QString *str, const char *s);
+void qstring_append_json(QString *str, const QObject *obj,
+                         bool pretty, int indent);
+
 #endif /* QJSON_H */
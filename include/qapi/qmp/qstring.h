@@ -31,6 +31,7 @@ const char *qstring_get_try_str(const QString *qstring);
 const char *qobject_get_try_str(const QObject *qstring);
 void qstring_append_int(QString *qstring, int64_t value);
 void qstring_append(QString *qstring, const char *str);
+void qstring_append_len(QString *qstring, const char *str, size_t len);
 void qstring_append_chr(QString *qstring, int c);
 bool qstring_is_equal(const QObject *x, const QObject *y);
 void qstring_destroy_obj(QObject *obj);
@@ -195,6 +195,8 @@ typedef struct DumpState {
                                   * finished. */
     uint8_t *guest_note;         /* ELF note content */
     size_t guest_note_size;
+    uint8_t *cheri_tag_note;     /* capability tag bitmap note */
+    size_t cheri_tag_note_size;
 } DumpState;
 
 uint16_t cpu_to_dump16(DumpState *s, uint16_t val);
@@ -483,6 +483,15 @@ int monitor_fprintf(FILE *stream, const char *fmt, ...)
     return 0;
 }
 
+/* Emit the JSON text @json of a QMP message to @mon, consuming it */
+static void qmp_send_json(Monitor *mon, QString *json)
+{
+    qstring_append_chr(json, '\n');
+    monitor_puts(mon, qstring_get_str(json));
+
+    qobject_unref(json);
+}
+
 static void qmp_send_response(Monitor *mon, const QDict *rsp)
 {
     const QObject *data = QOBJECT(rsp);
@@ -492,10 +501,7 @@ static void qmp_send_response(Monitor *mon, const QDict *rsp)
                                              qobject_to_json(data);
     assert(json != NULL);
 
-    qstring_append_chr(json, '\n');
-    monitor_puts(mon, qstring_get_str(json));
-
-    qobject_unref(json);
+    qmp_send_json(mon, json);
 }
 
 static MonitorQAPIEventConf monitor_qapi_event_conf[QAPI_EVENT__MAX] = {
@@ -506,6 +512,9 @@ static MonitorQAPIEventConf monitor_qapi_event_conf[QAPI_EVENT__MAX] = {
     [QAPI_EVENT_QUORUM_REPORT_BAD] = { 1000 * SCALE_MS },
     [QAPI_EVENT_QUORUM_FAILURE]    = { 1000 * SCALE_MS },
     [QAPI_EVENT_VSERPORT_CHANGE]   = { 1000 * SCALE_MS },
+#ifdef TARGET_CHERI
+    [QAPI_EVENT_CHERI_CAPABILITY_FAULT] = { 1000 * SCALE_MS },
+#endif
 };
 
 /*
@@ -4122,14 +4131,22 @@ static void monitor_qmp_dispatch(Monitor *mon, QObject *req)
     Monitor *old_mon;
     QDict *rsp;
     QDict *error;
+    QString *json;
 
     old_mon = cur_mon;
     cur_mon = mon;
 
-    rsp = qmp_dispatch(mon->qmp.commands, req, qmp_oob_enabled(mon));
+    /* Large results are written as JSON directly, bypassing a QDict */
+    rsp = qmp_dispatch_json(mon->qmp.commands, req, qmp_oob_enabled(mon),
+                            mon->flags & MONITOR_USE_PRETTY, &json);
 
     cur_mon = old_mon;
 
+    if (json) {
+        qmp_send_json(mon, json);
+        return;
+    }
+
     if (mon->qmp.commands == &qmp_cap_negotiation_commands) {
         error = qdict_get_qdict(rsp, "error");
         if (error
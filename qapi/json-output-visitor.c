@@ -0,0 +1,270 @@
+/*
+ * JSON Output Visitor
+ *
+ * This work is licensed under the terms of the GNU LGPL, version 2.1 or later.
+ * See the COPYING.LIB file in the top-level directory.
+ *
+ */
+
+#include "qemu/osdep.h"
+#include "qapi/json-output-visitor.h"
+#include "qapi/visitor-impl.h"
+#include "qemu/queue.h"
+#include "qapi/qmp/qjson.h"
+#include "qapi/qmp/qnum.h"
+#include "qapi/qmp/qstring.h"
+
+typedef struct JsonStackEntry {
+    bool is_list;
+    int count; /* Members written so far */
+    void *qapi; /* sanity check that caller uses same pointer */
+    QSLIST_ENTRY(JsonStackEntry) node;
+} JsonStackEntry;
+
+struct JsonOutputVisitor {
+    Visitor visitor;
+    QSLIST_HEAD(, JsonStackEntry) stack; /* Stack of unfinished containers */
+    int depth; /* Number of unfinished containers */
+    bool pretty;
+    int indent; /* Nesting level of the root value */
+    bool root_done; /* Root value has been started */
+    QString *str; /* JSON text written so far */
+    QString **result; /* User's storage location for result */
+};
+
+static JsonOutputVisitor *to_jov(Visitor *v)
+{
+    return container_of(v, JsonOutputVisitor, visitor);
+}
+
+static void json_output_newline(JsonOutputVisitor *jov, int level)
+{
+    int j;
+
+    qstring_append(jov->str, "\n");
+    for (j = 0; j < level; j++) {
+        qstring_append(jov->str, "    ");
+    }
+}
+
+/*
+ * Start a value named @name: write the separator, indentation and
+ * member key the enclosing container needs in front of it.
+ */
+static void json_output_name(JsonOutputVisitor *jov, const char *name)
+{
+    JsonStackEntry *e = QSLIST_FIRST(&jov->stack);
+
+    if (!e) {
+        /* Don't allow reuse of visitor on more than one root */
+        assert(!jov->root_done);
+        jov->root_done = true;
+        return;
+    }
+
+    if (e->count++) {
+        qstring_append(jov->str, jov->pretty ? "," : ", ");
+    }
+    if (jov->pretty) {
+        json_output_newline(jov, jov->indent + jov->depth);
+    }
+    if (e->is_list) {
+        assert(!name);
+    } else {
+        assert(name);
+        qstring_append_json_str(jov->str, name);
+        qstring_append(jov->str, ": ");
+    }
+}
+
+static void json_output_push(JsonOutputVisitor *jov, const char *name,
+                             bool is_list, void *qapi)
+{
+    JsonStackEntry *e = g_malloc0(sizeof(*e));
+
+    json_output_name(jov, name);
+    qstring_append(jov->str, is_list ? "[" : "{");
+    e->is_list = is_list;
+    e->qapi = qapi;
+    QSLIST_INSERT_HEAD(&jov->stack, e, node);
+    jov->depth++;
+}
+
+static void json_output_pop(JsonOutputVisitor *jov, bool is_list, void *qapi)
+{
+    JsonStackEntry *e = QSLIST_FIRST(&jov->stack);
+
+    assert(e);
+    assert(e->qapi == qapi);
+    assert(e->is_list == is_list);
+    QSLIST_REMOVE_HEAD(&jov->stack, node);
+    g_free(e);
+    jov->depth--;
+
+    if (jov->pretty) {
+        json_output_newline(jov, jov->indent + jov->depth);
+    }
+    qstring_append(jov->str, is_list ? "]" : "}");
+}
+
+static void json_output_start_struct(Visitor *v, const char *name,
+                                     void **obj, size_t unused, Error **errp)
+{
+    json_output_push(to_jov(v), name, false, obj);
+}
+
+static void json_output_end_struct(Visitor *v, void **obj)
+{
+    json_output_pop(to_jov(v), false, obj);
+}
+
+static void json_output_start_list(Visitor *v, const char *name,
+                                   GenericList **listp, size_t size,
+                                   Error **errp)
+{
+    json_output_push(to_jov(v), name, true, listp);
+}
+
+static GenericList *json_output_next_list(Visitor *v, GenericList *tail,
+                                          size_t size)
+{
+    return tail->next;
+}
+
+static void json_output_end_list(Visitor *v, void **obj)
+{
+    json_output_pop(to_jov(v), true, obj);
+}
+
+static void json_output_type_int64(Visitor *v, const char *name,
+                                   int64_t *obj, Error **errp)
+{
+    JsonOutputVisitor *jov = to_jov(v);
+
+    json_output_name(jov, name);
+    qstring_append_int(jov->str, *obj);
+}
+
+static void json_output_type_uint64(Visitor *v, const char *name,
+                                    uint64_t *obj, Error **errp)
+{
+    JsonOutputVisitor *jov = to_jov(v);
+    char buf[32];
+
+    json_output_name(jov, name);
+    snprintf(buf, sizeof(buf), "%" PRIu64, *obj);
+    qstring_append(jov->str, buf);
+}
+
+static void json_output_type_bool(Visitor *v, const char *name, bool *obj,
+                                  Error **errp)
+{
+    JsonOutputVisitor *jov = to_jov(v);
+
+    json_output_name(jov, name);
+    qstring_append(jov->str, *obj ? "true" : "false");
+}
+
+static void json_output_type_str(Visitor *v, const char *name, char **obj,
+                                 Error **errp)
+{
+    JsonOutputVisitor *jov = to_jov(v);
+
+    json_output_name(jov, name);
+    qstring_append_json_str(jov->str, *obj ? *obj : "");
+}
+
+static void json_output_type_number(Visitor *v, const char *name,
+                                    double *obj, Error **errp)
+{
+    JsonOutputVisitor *jov = to_jov(v);
+    QNum *qnum = qnum_from_double(*obj);
+    char *buffer;
+
+    /* Same formatting as qobject_to_json() */
+    json_output_name(jov, name);
+    buffer = qnum_to_string(qnum);
+    qstring_append(jov->str, buffer);
+    g_free(buffer);
+    qobject_unref(qnum);
+}
+
+static void json_output_type_any(Visitor *v, const char *name,
+                                 QObject **obj, Error **errp)
+{
+    JsonOutputVisitor *jov = to_jov(v);
+
+    json_output_name(jov, name);
+    qstring_append_json(jov->str, *obj, jov->pretty,
+                        jov->indent + jov->depth);
+}
+
+static void json_output_type_null(Visitor *v, const char *name,
+                                  QNull **obj, Error **errp)
+{
+    JsonOutputVisitor *jov = to_jov(v);
+
+    json_output_name(jov, name);
+    qstring_append(jov->str, "null");
+}
+
+/* Finish writing, and hand the JSON text to the caller.
+ * The caller becomes the string's owner, and should use
+ * qobject_unref() when done with it.  */
+static void json_output_complete(Visitor *v, void *opaque)
+{
+    JsonOutputVisitor *jov = to_jov(v);
+
+    /* A visit must have occurred, with each start paired with end.  */
+    assert(jov->root_done && QSLIST_EMPTY(&jov->stack));
+    assert(opaque == jov->result);
+
+    *jov->result = qobject_ref(jov->str);
+    jov->result = NULL;
+}
+
+static void json_output_free(Visitor *v)
+{
+    JsonOutputVisitor *jov = to_jov(v);
+    JsonStackEntry *e;
+
+    while (!QSLIST_EMPTY(&jov->stack)) {
+        e = QSLIST_FIRST(&jov->stack);
+        QSLIST_REMOVE_HEAD(&jov->stack, node);
+        g_free(e);
+    }
+
+    qobject_unref(jov->str);
+    g_free(jov);
+}
+
+Visitor *json_output_visitor_new(bool pretty, int indent, QString **result)
+{
+    JsonOutputVisitor *v;
+
+    v = g_malloc0(sizeof(*v));
+
+    v->visitor.type = VISITOR_OUTPUT;
+    v->visitor.start_struct = json_output_start_struct;
+    v->visitor.end_struct = json_output_end_struct;
+    v->visitor.start_list = json_output_start_list;
+    v->visitor.next_list = json_output_next_list;
+    v->visitor.end_list = json_output_end_list;
+    v->visitor.type_int64 = json_output_type_int64;
+    v->visitor.type_uint64 = json_output_type_uint64;
+    v->visitor.type_bool = json_output_type_bool;
+    v->visitor.type_str = json_output_type_str;
+    v->visitor.type_number = json_output_type_number;
+    v->visitor.type_any = json_output_type_any;
+    v->visitor.type_null = json_output_type_null;
+    v->visitor.complete = json_output_complete;
+    v->visitor.free = json_output_free;
+
+    v->pretty = pretty;
+    v->indent = indent;
+    v->str = qstring_new();
+    *result = NULL;
+    v->result = result;
+
+    return &v->visitor;
+}
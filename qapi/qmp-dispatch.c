@@ -17,6 +17,7 @@
 #include "qapi/qmp/qdict.h"
 #include "qapi/qmp/qjson.h"
 #include "qapi/qmp/qbool.h"
+#include "qapi/qmp/qstring.h"
 #include "sysemu/sysemu.h"
 
 static QDict *qmp_dispatch_check_obj(const QObject *request, bool allow_oob,
@@ -75,8 +76,14 @@ static QDict *qmp_dispatch_check_obj(const QObject *request, bool allow_oob,
     return dict;
 }
 
+/*
+ * Run the command @request asks for and return its result.  If @json
+ * is non-null and the command can write its result as JSON directly,
+ * store that text through @json instead, and return null.
+ */
 static QObject *do_qmp_dispatch(QmpCommandList *cmds, QObject *request,
-                                bool allow_oob, Error **errp)
+                                bool allow_oob, bool pretty, QString **json,
+                                Error **errp)
 {
     Error *local_err = NULL;
     bool oob;
@@ -128,9 +135,16 @@ static QObject *do_qmp_dispatch(QmpCommandList *cmds, QObject *request,
         qobject_ref(args);
     }
 
-    cmd->fn(args, &ret, &local_err);
+    if (json && cmd->fn_json) {
+        cmd->fn_json(args, json, pretty, &local_err);
+        assert(!*json == !!local_err);
+    } else {
+        cmd->fn(args, &ret, &local_err);
+    }
     if (local_err) {
         error_propagate(errp, local_err);
+    } else if (json && *json) {
+        /* Result is in *json */
     } else if (cmd->options & QCO_NO_SUCCESS_RESP) {
         g_assert(!ret);
     } else if (!ret) {
@@ -163,17 +177,60 @@ bool qmp_is_oob(const QDict *dict)
         && !qdict_haskey(dict, "execute");
 }
 
+/*
+ * Wrap the JSON text @ret for a command's result into the text of a
+ * success response with @id, formatted as qobject_to_json() (or
+ * qobject_to_json_pretty() if @pretty) would format the QDict
+ * qmp_dispatch() returns.  Consumes @ret.
+ */
+static QString *qmp_json_response(QString *ret, QObject *id, bool pretty)
+{
+    QString *rsp = qstring_from_str(pretty ? "{\n    " : "{");
+
+    qstring_append(rsp, "\"return\": ");
+    qstring_append(rsp, qstring_get_str(ret));
+    if (id) {
+        qstring_append(rsp, pretty ? ",\n    " : ", ");
+        qstring_append(rsp, "\"id\": ");
+        qstring_append_json(rsp, id, pretty, 1);
+    }
+    qstring_append(rsp, pretty ? "\n}" : "}");
+    qobject_unref(ret);
+    return rsp;
+}
+
 QDict *qmp_dispatch(QmpCommandList *cmds, QObject *request,
                     bool allow_oob)
+{
+    return qmp_dispatch_json(cmds, request, allow_oob, false, NULL);
+}
+
+/*
+ * Like qmp_dispatch(), but if @json is non-null and the command can
+ * write its result as JSON directly, skip building the response QDict:
+ * store the complete response text through @json and return null.
+ * @pretty selects qobject_to_json_pretty() formatting for that text.
+ * Otherwise, *@json is set to null.
+ */
+QDict *qmp_dispatch_json(QmpCommandList *cmds, QObject *request,
+                         bool allow_oob, bool pretty, QString **json)
 {
     Error *err = NULL;
     QDict *dict = qobject_to(QDict, request);
     QObject *ret, *id = dict ? qdict_get(dict, "id") : NULL;
+    QString *ret_json = NULL;
     QDict *rsp;
 
-    ret = do_qmp_dispatch(cmds, request, allow_oob, &err);
+    ret = do_qmp_dispatch(cmds, request, allow_oob, pretty,
+                          json ? &ret_json : NULL, &err);
+    if (json) {
+        *json = NULL;
+    }
     if (err) {
         rsp = qmp_error_response(err);
+    } else if (ret_json) {
+        *json = qmp_json_response(ret_json, id, pretty);
+        return NULL;
     } else if (ret) {
         rsp = qdict_new();
         qdict_put_obj(rsp, "return", ret);
@@ -27,6 +27,15 @@ void qmp_register_command(QmpCommandList *cmds, const char *name,
     QTAILQ_INSERT_TAIL(cmds, cmd, node);
 }
 
+void qmp_register_command_json(QmpCommandList *cmds, const char *name,
+                               QmpCommandFuncJSON *fn_json)
+{
+    QmpCommand *cmd = qmp_find_command(cmds, name);
+
+    assert(cmd);
+    cmd->fn_json = fn_json;
+}
+
 QmpCommand *qmp_find_command(QmpCommandList *cmds, const char *name)
 {
     QmpCommand *cmd;
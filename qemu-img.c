@@ -174,7 +174,7 @@ static void QEMU_NORETURN help(void)
            "\n"
            "Parameters to convert subcommand:\n"
            "  '-m' specifies how many coroutines work in parallel during the convert\n"
-           "       process (defaults to 8)\n"
+           "       process (defaults to 8, at most 64)\n"
            "  '-W' allow to write to the target out of order rather than sequential\n"
            "\n"
            "Parameters to snapshot subcommand:\n"
@@ -1064,6 +1064,13 @@ done:
     return 0;
 }
 
+/*
+ * Number of sectors checked with a single buffer_is_zero() call when skipping
+ * over zeroed areas.  buffer_is_zero() is vectorized, so scanning large runs
+ * in one go is much cheaper than testing every sector individually.
+ */
+#define ZERO_SCAN_SECTORS 64
+
 /*
  * Returns -1 if 'buf' contains only zeroes, otherwise the byte index
  * of the first sector boundary within buf where the sector contains a
@@ -1072,12 +1079,18 @@ done:
  */
 static int64_t find_nonzero(const uint8_t *buf, int64_t n)
 {
-    int64_t i;
+    int64_t i, j, chunk;
     int64_t end = QEMU_ALIGN_DOWN(n, BDRV_SECTOR_SIZE);
 
-    for (i = 0; i < end; i += BDRV_SECTOR_SIZE) {
-        if (!buffer_is_zero(buf + i, BDRV_SECTOR_SIZE)) {
-            return i;
+    for (i = 0; i < end; i += chunk) {
+        chunk = MIN(ZERO_SCAN_SECTORS * BDRV_SECTOR_SIZE, end - i);
+        if (buffer_is_zero(buf + i, chunk)) {
+            continue;
+        }
+        for (j = i; j < i + chunk; j += BDRV_SECTOR_SIZE) {
+            if (!buffer_is_zero(buf + j, BDRV_SECTOR_SIZE)) {
+                return j;
+            }
         }
     }
     if (i < n && !buffer_is_zero(buf + i, n - end)) {
@@ -1106,10 +1119,19 @@ static int is_allocated_sectors(const uint8_t *buf, int n, int *pnum,
         *pnum = 0;
         return 0;
     }
-    is_zero = buffer_is_zero(buf, 512);
-    for(i = 1; i < n; i++) {
-        buf += 512;
-        if (is_zero != buffer_is_zero(buf, 512)) {
+    is_zero = buffer_is_zero(buf, BDRV_SECTOR_SIZE);
+    i = 1;
+    if (is_zero) {
+        /* skip over long zero runs a chunk at a time */
+        while (n - i >= ZERO_SCAN_SECTORS &&
+               buffer_is_zero(buf + i * BDRV_SECTOR_SIZE,
+                              ZERO_SCAN_SECTORS * BDRV_SECTOR_SIZE)) {
+            i += ZERO_SCAN_SECTORS;
+        }
+    }
+    for (; i < n; i++) {
+        if (is_zero != buffer_is_zero(buf + i * BDRV_SECTOR_SIZE,
+                                      BDRV_SECTOR_SIZE)) {
             break;
         }
     }
@@ -1548,7 +1570,7 @@ enum ImgConvertBlockStatus {
     BLK_BACKING_FILE,
 };
 
-#define MAX_COROUTINES 16
+#define MAX_COROUTINES 64
 
 typedef struct ImgConvertState {
     BlockBackend **src;
@@ -2446,6 +2468,15 @@ static int img_convert(int argc, char **argv)
             goto out;
         }
     } else {
+        /* Formats that can only be written with compressed clusters (such
+         * as VMDK streamOptimized) append them sequentially, so they need
+         * the writes to arrive in order. */
+        if (bdi.needs_compressed_writes && !s.wr_in_order) {
+            error_report("Out of order write is not supported for this "
+                         "file format");
+            ret = -1;
+            goto out;
+        }
         s.compressed = s.compressed || bdi.needs_compressed_writes;
         s.cluster_sectors = bdi.cluster_size / BDRV_SECTOR_SIZE;
         s.unallocated_blocks_are_zero = bdi.unallocated_blocks_are_zero;
@@ -3916,6 +3916,66 @@ STEXI
 Generate debugger exception when capability becomes unrepresentable.
 ETEXI
 
+DEF("cheri-verify-level", HAS_ARG, QEMU_OPTION_cheri_verify_level, \
+    "-cheri-verify-level [off|cheap|paranoid]     Select which CHERI invariant checks are run\n", QEMU_ARCH_ALL)
+STEXI
+@item -cheri-verify-level @var{level}
+@findex -cheri-verify-level
+Select which internal CHERI invariant checks are run: @code{off},
+@code{cheap} or @code{paranoid}. Levels above the one selected with
+configure's @option{--cheri-verify-level} are not compiled in; builds
+configured with @option{--enable-debug-tcg} compile in @code{paranoid} by
+default. @code{make check} runs the qtests of CHERI targets at
+@code{paranoid} when it is compiled in.
+ETEXI
+
+DEF("cheri-fault-log", HAS_ARG, QEMU_OPTION_cheri_fault_log, \
+    "-cheri-fault-log <file>     Write a binary record of every capability exception to <file>\n", QEMU_ARCH_ALL)
+STEXI
+@item -cheri-fault-log @var{file}
+@findex -cheri-fault-log
+Write a binary record (time, vCPU, PC, ASID, cause, faulting register and
+its capability) of every capability exception to @var{file}. Records are
+buffered per vCPU; see @code{struct cheri_fault_record} for the layout.
+ETEXI
+
+DEF("cheri-fault-events", 0, QEMU_OPTION_cheri_fault_events, \
+    "-cheri-fault-events     Emit a (rate-limited) QMP event for capability exceptions\n", QEMU_ARCH_ALL)
+STEXI
+@item -cheri-fault-events
+@findex -cheri-fault-events
+Emit the rate-limited @code{CHERI_CAPABILITY_FAULT} QMP event for capability
+exceptions.
+ETEXI
+
+DEF("cheri-no-tag-reclaim", 0, QEMU_OPTION_cheri_no_tag_reclaim, \
+    "-cheri-no-tag-reclaim     Do not free all-zero tag memory blocks in the background\n", QEMU_ARCH_ALL)
+STEXI
+@item -cheri-no-tag-reclaim
+@findex -cheri-no-tag-reclaim
+Do not start the background thread that frees tag memory blocks whose tags
+are all clear. Blocks can still be reclaimed explicitly with the
+@code{query-cheri-tag-memory} QMP command's reclaim argument.
+ETEXI
+
+DEF("afl-coverage", HAS_ARG, QEMU_OPTION_afl_coverage, \
+    "-afl-coverage [asid=n][,start=addr][,end=addr]\n"
+    "                record AFL-compatible edge coverage of the guest\n", QEMU_ARCH_ALL)
+STEXI
+@item -afl-coverage [asid=@var{n}][,start=@var{addr}][,end=@var{addr}]
+@findex -afl-coverage
+Instrument translated code to update an AFL-style edge coverage bitmap on
+every translation block entry. The bitmap is the shared memory segment
+named by the @env{__AFL_SHM_ID} environment variable (a private one is used
+if it is not set). Only blocks starting in [@var{start}, @var{end}) are
+instrumented, and if @var{asid} is given only edges executed in that
+address space are recorded.
+
+This only provides the coverage bitmap. QEMU does not implement the AFL
+fork server protocol, so each test case needs its own QEMU process or a
+harness inside the guest that resets its own state.
+ETEXI
+
 
 #endif
 
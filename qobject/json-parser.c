@@ -217,6 +217,18 @@ static QString *parse_string(JSONParserContext *ctxt, JSONToken *token)
             }
             /* fall through */
         default:
+            /* Copy runs of printable ASCII in one go */
+            for (end = (char *)ptr;
+                 *end >= 0x20 && *end < 0x7F &&
+                     *end != quote && *end != '\\' && *end != '%';
+                 end++) {
+            }
+            if (end != ptr) {
+                qstring_append_len(str, ptr, end - ptr);
+                ptr = end;
+                break;
+            }
+
             cp = mod_utf8_codepoint(ptr, 6, &end);
             if (cp < 0) {
                 parse_error(ctxt, token, "invalid UTF-8 sequence in string");
@@ -159,10 +159,75 @@ typedef struct ToJsonIterState
 
 static void to_json(const QObject *obj, QString *str, int pretty, int indent);
 
+static void to_json_str(const char *ptr, QString *str)
+{
+    const char *run;
+    int cp;
+    char buf[16];
+    char *end;
+
+    qstring_append(str, "\"");
+
+    while (*ptr) {
+        /* Copy runs of characters that need no escaping in one go */
+        for (run = ptr;
+             *ptr >= 0x20 && *ptr < 0x7F && *ptr != '"' && *ptr != '\\';
+             ptr++) {
+        }
+        if (ptr != run) {
+            qstring_append_len(str, run, ptr - run);
+            continue;
+        }
+
+        cp = mod_utf8_codepoint(ptr, 6, &end);
+        ptr = end;
+        switch (cp) {
+        case '\"':
+            qstring_append(str, "\\\"");
+            break;
+        case '\\':
+            qstring_append(str, "\\\\");
+            break;
+        case '\b':
+            qstring_append(str, "\\b");
+            break;
+        case '\f':
+            qstring_append(str, "\\f");
+            break;
+        case '\n':
+            qstring_append(str, "\\n");
+            break;
+        case '\r':
+            qstring_append(str, "\\r");
+            break;
+        case '\t':
+            qstring_append(str, "\\t");
+            break;
+        default:
+            if (cp < 0) {
+                cp = 0xFFFD; /* replacement character */
+            }
+            if (cp > 0xFFFF) {
+                /* beyond BMP; need a surrogate pair */
+                snprintf(buf, sizeof(buf), "\\u%04X\\u%04X",
+                         0xD800 + ((cp - 0x10000) >> 10),
+                         0xDC00 + ((cp - 0x10000) & 0x3FF));
+            } else if (cp < 0x20 || cp >= 0x7F) {
+                snprintf(buf, sizeof(buf), "\\u%04X", cp);
+            } else {
+                buf[0] = cp;
+                buf[1] = 0;
+            }
+            qstring_append(str, buf);
+        }
+    }
+
+    qstring_append(str, "\"");
+}
+
 static void to_json_dict_iter(const char *key, QObject *obj, void *opaque)
 {
     ToJsonIterState *s = opaque;
-    QString *qkey;
     int j;
 
     if (s->count) {
@@ -175,9 +240,7 @@ static void to_json_dict_iter(const char *key, QObject *obj, void *opaque)
             qstring_append(s->str, "    ");
     }
 
-    qkey = qstring_from_str(key);
-    to_json(QOBJECT(qkey), s->str, s->pretty, s->indent);
-    qobject_unref(qkey);
+    to_json_str(key, s->str);
 
     qstring_append(s->str, ": ");
     to_json(obj, s->str, s->pretty, s->indent);
@@ -211,65 +274,22 @@ static void to_json(const QObject *obj, QString *str, int pretty, int indent)
         break;
     case QTYPE_QNUM: {
         QNum *val = qobject_to(QNum, obj);
-        char *buffer = qnum_to_string(val);
+        char *buffer;
+
+        if (val->kind == QNUM_I64) {
+            /* The common case; format on the stack */
+            qstring_append_int(str, val->u.i64);
+            break;
+        }
+        buffer = qnum_to_string(val);
         qstring_append(str, buffer);
         g_free(buffer);
         break;
     }
     case QTYPE_QSTRING: {
         QString *val = qobject_to(QString, obj);
-        const char *ptr;
-        int cp;
-        char buf[16];
-        char *end;
-
-        ptr = qstring_get_str(val);
-        qstring_append(str, "\"");
-
-        for (; *ptr; ptr = end) {
-            cp = mod_utf8_codepoint(ptr, 6, &end);
-            switch (cp) {
-            case '\"':
-                qstring_append(str, "\\\"");
-                break;
-            case '\\':
-                qstring_append(str, "\\\\");
-                break;
-            case '\b':
-                qstring_append(str, "\\b");
-                break;
-            case '\f':
-                qstring_append(str, "\\f");
-                break;
-            case '\n':
-                qstring_append(str, "\\n");
-                break;
-            case '\r':
-                qstring_append(str, "\\r");
-                break;
-            case '\t':
-                qstring_append(str, "\\t");
-                break;
-            default:
-                if (cp < 0) {
-                    cp = 0xFFFD; /* replacement character */
-                }
-                if (cp > 0xFFFF) {
-                    /* beyond BMP; need a surrogate pair */
-                    snprintf(buf, sizeof(buf), "\\u%04X\\u%04X",
-                             0xD800 + ((cp - 0x10000) >> 10),
-                             0xDC00 + ((cp - 0x10000) & 0x3FF));
-                } else if (cp < 0x20 || cp >= 0x7F) {
-                    snprintf(buf, sizeof(buf), "\\u%04X", cp);
-                } else {
-                    buf[0] = cp;
-                    buf[1] = 0;
-                }
-                qstring_append(str, buf);
-            }
-        };
 
-        qstring_append(str, "\"");
+        to_json_str(qstring_get_str(val), str);
         break;
     }
     case QTYPE_QDICT: {
@@ -342,3 +362,22 @@ QString *qobject_to_json_pretty(const QObject *obj)
 
     return str;
 }
+
+/*
+ * Append @s to @str as a JSON string literal, escaped as
+ * qobject_to_json() would.
+ */
+void qstring_append_json_str(QString *str, const char *s)
+{
+    to_json_str(s, str);
+}
+
+/*
+ * Append the JSON text for @obj to @str.  With @pretty, format it as
+ * qobject_to_json_pretty() would for a value nested @indent levels deep.
+ */
+void qstring_append_json(QString *str, const QObject *obj,
+                         bool pretty, int indent)
+{
+    to_json(obj, str, pretty, indent);
+}
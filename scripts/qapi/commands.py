@@ -25,7 +25,7 @@ def gen_command_decl(name, arg_type, boxed, ret_type):
                  params=build_params(arg_type, boxed, 'Error **errp'))
 
 
-def gen_call(name, arg_type, boxed, ret_type):
+def gen_call(name, arg_type, boxed, ret_type, json=False):
     ret = ''
 
     argstr = ''
@@ -54,9 +54,11 @@ def gen_call(name, arg_type, boxed, ret_type):
         goto out;
     }
 
-    qmp_marshal_output_%(c_name)s(retval, ret, &err);
+    qmp_marshal_output_%(json)s%(c_name)s(retval, ret, %(pretty)s&err);
 ''',
-                     c_name=ret_type.c_name())
+                     c_name=ret_type.c_name(),
+                     json='json_' if json else '',
+                     pretty='pretty, ' if json else '')
     return ret
 
 
@@ -83,19 +85,46 @@ static void qmp_marshal_output_%(c_name)s(%(c_type)s ret_in, QObject **ret_out,
                  c_type=ret_type.c_type(), c_name=ret_type.c_name())
 
 
-def build_marshal_proto(name):
+def gen_marshal_output_json(ret_type):
+    # The return value is nested one level deep in the response object
+    return mcgen('''
+
+static void qmp_marshal_output_json_%(c_name)s(%(c_type)s ret_in, QString **ret_out, bool pretty, Error **errp)
+{
+    Error *err = NULL;
+    Visitor *v;
+
+    v = json_output_visitor_new(pretty, 1, ret_out);
+    visit_type_%(c_name)s(v, "unused", &ret_in, &err);
+    if (!err) {
+        visit_complete(v, ret_out);
+    }
+    error_propagate(errp, err);
+    visit_free(v);
+    v = qapi_dealloc_visitor_new();
+    visit_type_%(c_name)s(v, "unused", &ret_in, NULL);
+    visit_free(v);
+}
+''',
+                 c_type=ret_type.c_type(), c_name=ret_type.c_name())
+
+
+def build_marshal_proto(name, json=False):
+    if json:
+        return ('void qmp_marshal_json_%s(QDict *args, QString **ret, '
+                'bool pretty, Error **errp)' % c_name(name))
     return ('void qmp_marshal_%s(QDict *args, QObject **ret, Error **errp)'
             % c_name(name))
 
 
-def gen_marshal_decl(name):
+def gen_marshal_decl(name, json=False):
     return mcgen('''
 %(proto)s;
 ''',
-                 proto=build_marshal_proto(name))
+                 proto=build_marshal_proto(name, json))
 
 
-def gen_marshal(name, arg_type, boxed, ret_type):
+def gen_marshal(name, arg_type, boxed, ret_type, json=False):
     have_args = arg_type and not arg_type.is_empty()
 
     ret = mcgen('''
@@ -104,7 +133,7 @@ def gen_marshal(name, arg_type, boxed, ret_type):
 {
     Error *err = NULL;
 ''',
-                proto=build_marshal_proto(name))
+                proto=build_marshal_proto(name, json))
 
     if ret_type:
         ret += mcgen('''
@@ -153,7 +182,7 @@ def gen_marshal(name, arg_type, boxed, ret_type):
     }
 ''')
 
-    ret += gen_call(name, arg_type, boxed, ret_type)
+    ret += gen_call(name, arg_type, boxed, ret_type, json)
 
     ret += mcgen('''
 
@@ -193,7 +222,8 @@ out:
     return ret
 
 
-def gen_register_command(name, success_response, allow_oob, allow_preconfig):
+def gen_register_command(name, success_response, allow_oob, allow_preconfig,
+                         json):
     options = []
 
     if not success_response:
@@ -214,9 +244,21 @@ def gen_register_command(name, success_response, allow_oob, allow_preconfig):
 ''',
                 name=name, c_name=c_name(name),
                 opts=options)
+    if json:
+        ret += mcgen('''
+    qmp_register_command_json(cmds, "%(name)s",
+                              qmp_marshal_json_%(c_name)s);
+''',
+                     name=name, c_name=c_name(name))
     return ret
 
 
+def has_json_marshal(ret_type):
+    # Lists are where results get large; write those as JSON directly
+    # rather than building a QObject first
+    return isinstance(ret_type, QAPISchemaArrayType)
+
+
 def gen_registry(registry, prefix):
     ret = mcgen('''
 
@@ -255,6 +297,7 @@ class QAPISchemaGenCommandVisitor(QAPISchemaModularCVisitor):
 #include "qapi/qmp/qdict.h"
 #include "qapi/qobject-output-visitor.h"
 #include "qapi/qobject-input-visitor.h"
+#include "qapi/json-output-visitor.h"
 #include "qapi/dealloc-visitor.h"
 #include "qapi/error.h"
 #include "%(visit)s.h"
@@ -286,17 +329,25 @@ void %(c_prefix)sqmp_init_marshal(QmpCommandList *cmds);
         # conjunction of the T-returning commands' conditions.  If T
         # is a built-in type, this isn't possible: the
         # qmp_marshal_output_T() will be generated unconditionally.
+        json = has_json_marshal(ret_type)
         if ret_type and ret_type not in self._visited_ret_types[self._genc]:
             self._visited_ret_types[self._genc].add(ret_type)
             with ifcontext(ret_type.ifcond,
                            self._genh, self._genc, self._regy):
                 self._genc.add(gen_marshal_output(ret_type))
+                if json:
+                    self._genc.add(gen_marshal_output_json(ret_type))
         with ifcontext(ifcond, self._genh, self._genc, self._regy):
             self._genh.add(gen_command_decl(name, arg_type, boxed, ret_type))
             self._genh.add(gen_marshal_decl(name))
             self._genc.add(gen_marshal(name, arg_type, boxed, ret_type))
+            if json:
+                self._genh.add(gen_marshal_decl(name, json))
+                self._genc.add(gen_marshal(name, arg_type, boxed, ret_type,
+                                           json))
             self._regy.add(gen_register_command(name, success_response,
-                                                allow_oob, allow_preconfig))
+                                                allow_oob, allow_preconfig,
+                                                json))
 
 
 def gen_commands(schema, output_dir, prefix):
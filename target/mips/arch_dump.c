@@ -0,0 +1,112 @@
+/*
+ * Support for writing ELF notes for MIPS architectures
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "qemu/osdep.h"
+#include "cpu.h"
+#include "internal.h"
+#include "elf.h"
+#include "sysemu/dump.h"
+
+#if defined(TARGET_MIPS64)
+
+/* elf_gregset_t layout from arch/mips/include/asm/reg.h */
+#define MIPS64_EF_R0            0
+#define MIPS64_EF_LO            32
+#define MIPS64_EF_HI            33
+#define MIPS64_EF_CP0_EPC       34
+#define MIPS64_EF_CP0_BADVADDR  35
+#define MIPS64_EF_CP0_STATUS    36
+#define MIPS64_EF_CP0_CAUSE     37
+#define MIPS64_ELF_NGREG        45
+
+/* struct elf_prstatus from include/uapi/linux/elfcore.h */
+struct mips64_elf_prstatus {
+    char pad1[32]; /* 32 == offsetof(struct elf_prstatus, pr_pid) */
+    uint32_t pr_pid;
+    char pad2[76]; /* 76 == offsetof(struct elf_prstatus, pr_reg) -
+                            offsetof(struct elf_prstatus, pr_ppid) */
+    uint64_t pr_reg[MIPS64_ELF_NGREG];
+    uint32_t pr_fpvalid;
+    char pad3[4];
+} QEMU_PACKED;
+
+QEMU_BUILD_BUG_ON(sizeof(struct mips64_elf_prstatus) != 480);
+
+struct mips64_note {
+    Elf64_Nhdr hdr;
+    char name[8]; /* align_up(sizeof("CORE"), 4) */
+    struct mips64_elf_prstatus prstatus;
+} QEMU_PACKED;
+
+#define MIPS64_PRSTATUS_NOTE_SIZE sizeof(struct mips64_note)
+
+int mips_cpu_write_elf64_note(WriteCoreDumpFunction f, CPUState *cs,
+                              int cpuid, void *opaque)
+{
+    struct mips64_note note;
+    CPUMIPSState *env = &MIPS_CPU(cs)->env;
+    DumpState *s = opaque;
+    uint64_t *regs = note.prstatus.pr_reg;
+    int i;
+
+    memset(&note, 0, sizeof(note));
+    note.hdr.n_namesz = cpu_to_dump32(s, 5);
+    note.hdr.n_descsz = cpu_to_dump32(s, sizeof(note.prstatus));
+    note.hdr.n_type = cpu_to_dump32(s, NT_PRSTATUS);
+    memcpy(note.name, "CORE", 5);
+
+    note.prstatus.pr_pid = cpu_to_dump32(s, cpuid);
+
+    for (i = 0; i < 32; i++) {
+        regs[MIPS64_EF_R0 + i] = cpu_to_dump64(s, env->active_tc.gpr[i]);
+    }
+    regs[MIPS64_EF_LO] = cpu_to_dump64(s, env->active_tc.LO[0]);
+    regs[MIPS64_EF_HI] = cpu_to_dump64(s, env->active_tc.HI[0]);
+    /* Report the interrupted PC, which is what a debugger wants to see */
+    regs[MIPS64_EF_CP0_EPC] = cpu_to_dump64(s, env->active_tc.PC);
+    regs[MIPS64_EF_CP0_BADVADDR] = cpu_to_dump64(s, env->CP0_BadVAddr);
+    regs[MIPS64_EF_CP0_STATUS] = cpu_to_dump64(s, env->CP0_Status);
+    regs[MIPS64_EF_CP0_CAUSE] = cpu_to_dump64(s, env->CP0_Cause);
+
+    if (f(&note, MIPS64_PRSTATUS_NOTE_SIZE, s) < 0) {
+        return -1;
+    }
+    return 0;
+}
+
+int cpu_get_dump_info(ArchDumpInfo *info,
+                      const GuestPhysBlockList *guest_phys_blocks)
+{
+    info->d_machine = EM_MIPS;
+    info->d_class = ELFCLASS64;
+#ifdef TARGET_WORDS_BIGENDIAN
+    info->d_endian = ELFDATA2MSB;
+#else
+    info->d_endian = ELFDATA2LSB;
+#endif
+    return 0;
+}
+
+ssize_t cpu_get_note_size(int class, int machine, int nr_cpus)
+{
+    if (class != ELFCLASS64) {
+        return -1;
+    }
+    return MIPS64_PRSTATUS_NOTE_SIZE * nr_cpus;
+}
+
+#endif /* TARGET_MIPS64 */
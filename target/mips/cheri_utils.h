@@ -38,6 +38,30 @@
 #include "tcg/tcg.h"  // for tcg_debug_assert()
 #define cheri_debug_assert(cond) tcg_debug_assert(cond)
 
+/*
+ * Cross-checks of CHERI invariants on hot paths. CONFIG_CHERI_VERIFY_LEVEL
+ * (configure --cheri-verify-level) is the most expensive level compiled in,
+ * -cheri-verify-level can lower it at run time. Checks above the configured
+ * level are removed entirely.
+ */
+#define CHERI_VERIFY_OFF        0
+#define CHERI_VERIFY_CHEAP      1
+#define CHERI_VERIFY_PARANOID   2
+
+#ifndef CONFIG_CHERI_VERIFY_LEVEL
+#define CONFIG_CHERI_VERIFY_LEVEL CHERI_VERIFY_CHEAP
+#endif
+
+extern int cheri_verify_level;
+
+#define cheri_verify_enabled(level) \
+    (CONFIG_CHERI_VERIFY_LEVEL >= (level) && cheri_verify_level >= (level))
+#define cheri_verify_assert(level, cond) do { \
+    if (cheri_verify_enabled(level)) { \
+        assert(cond); \
+    } \
+} while (0)
+
 /* Don't define the functions for CHERI256 (but we need CAP_MAX_OTYPE) */
 #ifdef CHERI_128
 // Don't use _sbit_for_memory in cheri256 cap_register_t
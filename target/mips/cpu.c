@@ -174,6 +174,12 @@ static void mips_cpu_realizefn(DeviceState *dev, Error **errp)
 
     cpu_mips_realize_env(&cpu->env);
 
+#if defined(TARGET_CHERI)
+    if (cheri_fault_log_file && !cheri_fault_log_open(errp)) {
+        return;
+    }
+#endif
+
     cpu_reset(cs);
     qemu_init_vcpu(cs);
 
@@ -260,6 +266,9 @@ static void mips_cpu_class_init(ObjectClass *c, void *data)
     cc->do_unaligned_access = mips_cpu_do_unaligned_access;
     cc->get_phys_page_debug = mips_cpu_get_phys_page_debug;
     cc->vmsd = &vmstate_mips_cpu;
+#ifdef TARGET_MIPS64
+    cc->write_elf64_note = mips_cpu_write_elf64_note;
+#endif
 #endif
     cc->disas_set_info = mips_cpu_disas_set_info;
 #ifdef CONFIG_TCG
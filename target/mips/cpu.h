@@ -10,6 +10,7 @@
 #include "mips-defs.h"
 #include "exec/cpu-defs.h"
 #include "fpu/softfloat.h"
+#include "qemu/log.h"
 
 #define TCG_GUEST_DEFAULT_MO (0)
 
@@ -156,6 +157,33 @@ typedef struct cvtrace cvtrace_t;
 
 #if defined(TARGET_CHERI)
 
+/*
+ * Record written for each capability exception to the -cheri-fault-log file.
+ * Like cvtrace, fields are in target byte order. The file starts with a
+ * CHERI_FAULT_LOG_MAGIC header padded to the size of one record.
+ */
+struct cheri_fault_record {
+    uint64_t timestamp; /* Host time in ns. */
+    uint64_t pc;        /* PC of the faulting instruction. */
+    uint16_t thread;    /* Hardware thread/CPU (i.e. cpu->cpu_index ) */
+    uint8_t asid;       /* Address Space ID (i.e. CP0_EntryHi & 0xff) */
+    uint8_t cause;      /* CP2Ca_* cause code. */
+    uint8_t reg;        /* Faulting capability register, 0xff for PCC. */
+    uint8_t cap_tag;    /* Decoded faulting capability (zero if unknown). */
+    uint8_t cap_sealed;
+    uint8_t pad;
+    uint32_t cap_perms; /* Including uperms. */
+    uint32_t cap_otype;
+    uint64_t cap_base;
+    uint64_t cap_length;
+    uint64_t cap_offset;
+} __attribute__((packed));
+typedef struct cheri_fault_record cheri_fault_record_t;
+
+#define CHERI_FAULT_LOG_MAGIC   "CheriFaultV01"
+/* Records buffered per vCPU before they are written out. */
+#define CHERI_FAULT_LOG_BUFSZ   64
+
 #if defined(CHERI_MAGIC128)
 #define CHERI_CAP_SIZE  16
 #elif defined(CHERI_128)
@@ -1235,6 +1263,9 @@ struct CPUMIPSState {
     uint64_t statcounters_unrepresentable_caps;
     /* TODO: we could implement the TLB ones as well */
 
+    /* Location of the previous TB for -afl-coverage edge hashing */
+    uint32_t afl_prev_loc;
+
     /*
      * See section 4.4.2 (Table 4.3) of the CHERI Architecture Reference.
      */
@@ -1298,6 +1329,11 @@ struct CPUMIPSState {
     QEMUTimer *timer; /* Internal timer */
     struct MIPSITUState *itu;
     MemoryRegion *itc_tag; /* ITC Configuration Tags */
+#ifdef TARGET_CHERI
+    /* Pending -cheri-fault-log records of this vCPU. */
+    cheri_fault_record_t *fault_log;
+    unsigned fault_log_count;
+#endif
 #ifdef CONFIG_MIPS_LOG_INSTR
     /*
      * Processor state after the last instruction.
@@ -1473,6 +1509,25 @@ static inline void restore_snan_bit_mode(CPUMIPSState *env)
                         &env->active_fpu.fp_status);
 }
 
+/*
+ * Set in the TB flags (never in hflags) when instruction logging is active.
+ * Translations made without it emit no per-instruction logging helpers, and
+ * since TB lookup compares flags, toggling logging picks up a separate set
+ * of translations instead of requiring a tb_flush().
+ */
+#define MIPS_TBFLAG_LOG_INSTR 0x80000000
+
+static inline bool mips_log_instr_enabled(CPUMIPSState *env)
+{
+#ifdef CONFIG_MIPS_LOG_INSTR
+    return unlikely(qemu_loglevel_mask(CPU_LOG_INSTR | CPU_LOG_CVTRACE |
+                                       CPU_LOG_USER_ONLY) ||
+                    env->user_only_tracing_enabled);
+#else
+    return false;
+#endif
+}
+
 static inline void cpu_get_tb_cpu_state(CPUMIPSState *env, target_ulong *pc,
                                         target_ulong *cs_base, uint32_t *flags)
 {
@@ -1480,6 +1535,9 @@ static inline void cpu_get_tb_cpu_state(CPUMIPSState *env, target_ulong *pc,
     *cs_base = 0;
     *flags = env->hflags & (MIPS_HFLAG_TMASK | MIPS_HFLAG_BMASK |
                             MIPS_HFLAG_HWRENA_ULR);
+    if (mips_log_instr_enabled(env)) {
+        *flags |= MIPS_TBFLAG_LOG_INSTR;
+    }
 }
 
 static inline bool should_use_error_epc(CPUMIPSState *env)
@@ -1510,8 +1568,12 @@ static inline bool in_kernel_mode(CPUMIPSState *env) {
 
 
 #if defined(TARGET_CHERI)
+extern bool cheri_tag_reclaim_enabled;
 void cheri_tag_phys_invalidate(ram_addr_t paddr, ram_addr_t len);
 void cheri_tag_init(uint64_t memory_size);
+unsigned cheri_tag_granule_shift(void);
+bool cheri_tag_phys_get_bitmap(ram_addr_t ram_addr, ram_addr_t len,
+                               uint8_t *bitmap);
 void cheri_tag_invalidate(CPUMIPSState *env, target_ulong vaddr, int32_t size,
                           uintptr_t pc);
 int  cheri_tag_get(CPUMIPSState *env, target_ulong vaddr, int reg,
@@ -1520,8 +1582,16 @@ int  cheri_tag_get_many(CPUMIPSState *env, target_ulong vaddr, int reg,
         hwaddr *ret_paddr, uintptr_t pc);
 void cheri_tag_set(CPUMIPSState *env, target_ulong vaddr, int reg,
         uintptr_t pc);
+bool cheri_copy_with_tags(CPUMIPSState *env, target_ulong dst_vaddr,
+        target_ulong src_vaddr, uint32_t len, bool preserve_tags,
+        bool store_local, uintptr_t pc);
+target_ulong check_capreg_range(CPUMIPSState *env, uint16_t regnum,
+        uint32_t perms, uint64_t len, uintptr_t retpc);
 void cheri_cpu_dump_statistics(CPUState *cs, FILE*f,
                                fprintf_function cpu_fprintf, int flags);
+void cheri_log_c2_exception(CPUMIPSState *env, uint16_t cause, uint16_t reg,
+                            uintptr_t retpc);
+bool cheri_fault_log_open(Error **errp);
 void print_capreg(FILE* f, const cap_register_t *cr, const char* prefix, const char* name);
 target_ulong check_ddc(CPUMIPSState *env, uint32_t perm, uint64_t addr, uint32_t len, bool instavail, uintptr_t retpc);
 #ifdef CHERI_MAGIC128
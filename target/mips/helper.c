@@ -25,8 +25,10 @@
 #include "exec/log.h"
 #include "qemu/atomic.h"
 #include "qemu/error-report.h"
+#include "qemu/cutils.h"
 #include "hw/mips/cpudevs.h"
 #include "qapi/qapi-commands-target.h"
+#include "qemu/rcu.h"
 
 enum {
 #ifdef TARGET_CHERI
@@ -72,74 +74,103 @@ int fixed_mmu_map_address (CPUMIPSState *env, hwaddr *physical, int *prot,
 }
 
 /* MIPS32/MIPS64 R4000-style MMU emulation */
+static inline bool r4k_tlb_match(CPUMIPSState *env, r4k_tlb_t *tlb,
+                                 target_ulong address, uint16_t ASID)
+{
+    /* 1k pages are not supported. */
+    target_ulong mask = tlb->PageMask | ~(TARGET_PAGE_MASK << 1);
+    target_ulong tag = address & ~mask;
+    target_ulong VPN = tlb->VPN & ~mask;
+#if defined(TARGET_MIPS64)
+    tag &= env->SEGMask;
+#endif
+
+    /* Check ASID, virtual page number & size */
+    return (tlb->G == 1 || tlb->ASID == ASID) && VPN == tag && !tlb->EHINV;
+}
+
 int r4k_map_address (CPUMIPSState *env, hwaddr *physical, int *prot,
                      target_ulong address, int rw, int access_type)
 {
     uint16_t ASID = env->CP0_EntryHi & env->CP0_EntryHi_ASID_mask;
-    int i;
-
-    for (i = 0; i < env->tlb->tlb_in_use; i++) {
-        r4k_tlb_t *tlb = &env->tlb->mmu.r4k.tlb[i];
-        /* 1k pages are not supported. */
-        target_ulong mask = tlb->PageMask | ~(TARGET_PAGE_MASK << 1);
-        target_ulong tag = address & ~mask;
-        target_ulong VPN = tlb->VPN & ~mask;
-#if defined(TARGET_MIPS64)
-        tag &= env->SEGMask;
-#endif
+    uint32_t i = env->tlb->last_match;
+    r4k_tlb_t *tlb;
+    target_ulong mask;
+    int n;
 
-        /* Check ASID, virtual page number & size */
-        if ((tlb->G == 1 || tlb->ASID == ASID) && VPN == tag && !tlb->EHINV) {
-            /* TLB match */
-            int n = !!(address & mask & ~(mask >> 1));
-            /* Check access rights */
-            if (!(n ? tlb->V1 : tlb->V0)) {
-                return TLBRET_INVALID;
+    /*
+     * Successive softmmu misses mostly land in the same guest entry (e.g.
+     * a large kernel page), so try the last match before the linear scan.
+     * Only regular entries are remembered: a shadow entry above nb_tlb
+     * must not win over a regular entry that was written after it.
+     */
+    if (i >= env->tlb->nb_tlb ||
+        !r4k_tlb_match(env, &env->tlb->mmu.r4k.tlb[i], address, ASID)) {
+        for (i = 0; i < env->tlb->tlb_in_use; i++) {
+            if (r4k_tlb_match(env, &env->tlb->mmu.r4k.tlb[i], address, ASID)) {
+                break;
             }
+        }
+        if (i < env->tlb->nb_tlb) {
+            env->tlb->last_match = i;
+        }
+    }
+
+    if (i >= env->tlb->tlb_in_use) {
+        return TLBRET_NOMATCH;
+    }
+
+    tlb = &env->tlb->mmu.r4k.tlb[i];
+    mask = tlb->PageMask | ~(TARGET_PAGE_MASK << 1);
+
+    /* TLB match */
+    n = !!(address & mask & ~(mask >> 1));
+    /* Check access rights */
+    if (!(n ? tlb->V1 : tlb->V0)) {
+        return TLBRET_INVALID;
+    }
 #if defined(TARGET_CHERI)
-            if (rw == MMU_DATA_CAP_LOAD && (n ? tlb->L1 : tlb->L0)) {
-                env->TLB_L = 1;
-            } else {
-                env->TLB_L = 0;
-            }
-            if (rw == MMU_DATA_CAP_STORE) {
-                /*
-                 * If we're trying to do a cap-store, first check for the
-                 * dirty/store-permitted bit before looking at the the
-                 * store-capability inhibit.
-                 */
-                if (!(n ? tlb->D1 : tlb->D0)) {
-                    return TLBRET_DIRTY;
-                }
-                if (n ? tlb->S1 : tlb->S0) {
-                    return TLBRET_S;
-                }
-            }
+    if (rw == MMU_DATA_CAP_LOAD && (n ? tlb->L1 : tlb->L0)) {
+        env->TLB_L = 1;
+    } else {
+        env->TLB_L = 0;
+    }
+    if (rw == MMU_DATA_CAP_STORE) {
+        /*
+         * If we're trying to do a cap-store, first check for the
+         * dirty/store-permitted bit before looking at the the
+         * store-capability inhibit.
+         */
+        if (!(n ? tlb->D1 : tlb->D0)) {
+            return TLBRET_DIRTY;
+        }
+        if (n ? tlb->S1 : tlb->S0) {
+            return TLBRET_S;
+        }
+    }
 #else
-            if (rw == MMU_INST_FETCH && (n ? tlb->XI1 : tlb->XI0)) {
-                return TLBRET_XI;
-            }
-            if (rw == MMU_DATA_LOAD && (n ? tlb->RI1 : tlb->RI0)) {
-                return TLBRET_RI;
-            }
+    if (rw == MMU_INST_FETCH && (n ? tlb->XI1 : tlb->XI0)) {
+        return TLBRET_XI;
+    }
+    if (rw == MMU_DATA_LOAD && (n ? tlb->RI1 : tlb->RI0)) {
+        return TLBRET_RI;
+    }
 #endif /* TARGET_CHERI */
 
-            if (( (rw != MMU_DATA_STORE)
+    if (( (rw != MMU_DATA_STORE)
 #if defined(TARGET_CHERI)
-                  && (rw != MMU_DATA_CAP_STORE)
+          && (rw != MMU_DATA_CAP_STORE)
 #endif
-                ) || (n ? tlb->D1 : tlb->D0)) {
+        ) || (n ? tlb->D1 : tlb->D0)) {
 
-                *physical = tlb->PFN[n] | (address & (mask >> 1));
-                *prot = PAGE_READ;
-                if (n ? tlb->D1 : tlb->D0)
-                    *prot |= PAGE_WRITE;
-                return TLBRET_MATCH;
-            }
-            return TLBRET_DIRTY;
-        }
+        *physical = tlb->PFN[n] | (address & (mask >> 1));
+        *prot = PAGE_READ;
+        if (n ? tlb->D1 : tlb->D0)
+            *prot |= PAGE_WRITE;
+        env->tlb->last_match_size = (mask >> 1) + 1;
+        return TLBRET_MATCH;
     }
-    return TLBRET_NOMATCH;
+    return TLBRET_DIRTY;
 }
 
 static int is_seg_am_mapped(unsigned int am, bool eu, int mmu_idx)
@@ -942,6 +973,42 @@ refill:
 #endif
 #endif
 
+#if !defined(CONFIG_USER_ONLY)
+/* Neighbouring softmmu pages filled alongside a miss in a multi-page entry */
+#define MIPS_TLB_PREFILL_PAGES 8
+
+/*
+ * Install @address in the softmmu TLB.  If the guest TLB entry it came
+ * from maps more than one target page, also install the neighbouring
+ * pages of an aligned window inside the same half of the entry: they
+ * share the PFN run and permissions, and kernels touching memory mapped
+ * with large pages would otherwise take a softmmu miss and a guest TLB
+ * lookup for each of them in turn.
+ */
+static void mips_tlb_set_page(CPUState *cs, vaddr address, hwaddr physical,
+                              int prot, int mmu_idx, target_ulong map_size)
+{
+    vaddr page = address & TARGET_PAGE_MASK;
+    hwaddr phys_page = physical & TARGET_PAGE_MASK;
+    target_ulong window;
+    vaddr base, v;
+
+    tlb_set_page(cs, page, phys_page, prot, mmu_idx, TARGET_PAGE_SIZE);
+
+    window = MIN(map_size, MIPS_TLB_PREFILL_PAGES * TARGET_PAGE_SIZE);
+    if (window <= TARGET_PAGE_SIZE) {
+        return;
+    }
+    base = address & ~(vaddr)(window - 1);
+    for (v = base; v < base + window; v += TARGET_PAGE_SIZE) {
+        if (v != page) {
+            tlb_set_page(cs, v, phys_page + (hwaddr)(v - page), prot,
+                         mmu_idx, TARGET_PAGE_SIZE);
+        }
+    }
+}
+#endif
+
 int mips_cpu_handle_mmu_fault(CPUState *cs, vaddr address, int size, int rw,
                               int mmu_idx)
 {
@@ -965,6 +1032,7 @@ int mips_cpu_handle_mmu_fault(CPUState *cs, vaddr address, int size, int rw,
 #if !defined(CONFIG_USER_ONLY)
     /* XXX: put correct access by using cpu_restore_state() correctly */
     access_type = ACCESS_INT;
+    env->tlb->last_match_size = 0;
     ret = get_physical_address(env, &physical, &prot,
                                address, rw, access_type, mmu_idx);
     switch (ret) {
@@ -980,9 +1048,8 @@ int mips_cpu_handle_mmu_fault(CPUState *cs, vaddr address, int size, int rw,
         break;
     }
     if (ret == TLBRET_MATCH) {
-        tlb_set_page(cs, address & TARGET_PAGE_MASK,
-                     physical & TARGET_PAGE_MASK, prot | PAGE_EXEC,
-                     mmu_idx, TARGET_PAGE_SIZE);
+        mips_tlb_set_page(cs, address, physical, prot | PAGE_EXEC, mmu_idx,
+                          env->tlb->last_match_size);
         ret = 0;
     } else if (ret < 0)
 #endif
@@ -1000,12 +1067,13 @@ int mips_cpu_handle_mmu_fault(CPUState *cs, vaddr address, int size, int rw,
             ret_walker = page_table_walk_refill(env, address, rw, mmu_idx);
             env->hflags |= mode;
             if (ret_walker) {
+                env->tlb->last_match_size = 0;
                 ret = get_physical_address(env, &physical, &prot,
                                            address, rw, access_type, mmu_idx);
                 if (ret == TLBRET_MATCH) {
-                    tlb_set_page(cs, address & TARGET_PAGE_MASK,
-                            physical & TARGET_PAGE_MASK, prot | PAGE_EXEC,
-                            mmu_idx, TARGET_PAGE_SIZE);
+                    mips_tlb_set_page(cs, address, physical,
+                                      prot | PAGE_EXEC, mmu_idx,
+                                      env->tlb->last_match_size);
                     ret = 0;
                     return ret;
                 }
@@ -1185,8 +1253,21 @@ void mips_cpu_do_interrupt(CPUState *cs)
     target_ulong offset;
     int cause = -1;
     const char *name = "";
+    /*
+     * Purecap runtimes may take a capability fault per lazily revoked or
+     * guard-page access, so check all the logging/tracing conditions once
+     * and keep the common untraced delivery free of them.
+     */
+    const bool traced = unlikely(qemu_loglevel_mask(CPU_LOG_INT |
+                                                    CPU_LOG_INSTR |
+                                                    CPU_LOG_CVTRACE |
+                                                    CPU_LOG_USER_ONLY)
+#ifdef CONFIG_MIPS_LOG_INSTR
+                                 || env->user_only_tracing_enabled
+#endif
+                                 );
 
-    if ((qemu_loglevel_mask(CPU_LOG_INT) || qemu_loglevel_mask(CPU_LOG_INSTR))
+    if (traced && qemu_loglevel_mask(CPU_LOG_INT | CPU_LOG_INSTR)
         && cs->exception_index != EXCP_EXT_INTERRUPT) {
         if (cs->exception_index < 0 || cs->exception_index > EXCP_LAST) {
             name = "unknown";
@@ -1204,8 +1285,9 @@ void mips_cpu_do_interrupt(CPUState *cs)
 #endif
     }
 #ifdef CONFIG_MIPS_LOG_INSTR
-    if (unlikely(qemu_loglevel_mask(CPU_LOG_INSTR | CPU_LOG_CVTRACE | CPU_LOG_USER_ONLY)
-        || env->user_only_tracing_enabled)) {
+    if (traced && (qemu_loglevel_mask(CPU_LOG_INSTR | CPU_LOG_CVTRACE |
+                                      CPU_LOG_USER_ONLY) ||
+                   env->user_only_tracing_enabled)) {
         helper_dump_changed_state(env);
     }
 #endif /* CONFIG_MIPS_LOG_INSTR */
@@ -1533,6 +1615,9 @@ void mips_cpu_do_interrupt(CPUState *cs)
             env->active_tc.PCC.cr_base;
 #endif /* TARGET_CHERI */
 
+    if (likely(!traced)) {
+        goto done;
+    }
 #ifdef CONFIG_MIPS_LOG_INSTR
     if (unlikely(qemu_loglevel_mask(CPU_LOG_INSTR))) {
         if (cs->exception_index == EXCP_EXT_INTERRUPT)
@@ -1572,6 +1657,7 @@ void mips_cpu_do_interrupt(CPUState *cs)
         dump_changed_capreg(env, &env->active_tc.CHWR.ErrorEPCC, &tmp, "ErrorEPCC");
 #endif
     }
+ done:
 #endif
     cs->exception_index = EXCP_NONE;
 #ifdef TARGET_CHERI
@@ -1692,14 +1778,16 @@ void r4k_invalidate_tlb (CPUMIPSState *env, int idx, int use_extra)
           * large as main memory. Fortunately, for this implementation
           * tags are not needed everywhere and sparsely allocated.
           */
-#define CAP_TAGBLK_SZ       ((1 << CAP_TAGBLK_SHFT) * 16)
-#define CAP_TAGBLK_IDX(tag_idx) (((tag_idx) & CAP_TAGBLK_MSK) * 16)
+#define CAP_TAGBLK_ENTRY_SZ 16
+#define CAP_TAGBLK_SZ       ((1 << CAP_TAGBLK_SHFT) * CAP_TAGBLK_ENTRY_SZ)
+#define CAP_TAGBLK_IDX(tag_idx) (((tag_idx) & CAP_TAGBLK_MSK) * CAP_TAGBLK_ENTRY_SZ)
 #if defined(HOST_WORDS_BIGENDIAN)
 #   define CAP_TAG_TPS_SHFT 0
 #else
 #   define CAP_TAG_TPS_SHFT 8
 #endif
 #else /* ! CHERI_MAGIC128 */
+#define CAP_TAGBLK_ENTRY_SZ 1
 #define CAP_TAGBLK_SZ       (1 << CAP_TAGBLK_SHFT)
 #define CAP_TAGBLK_IDX(tag_idx) ((tag_idx) & CAP_TAGBLK_MSK)
 #endif /* ! CHERI_MAGIC128 */
@@ -1707,9 +1795,108 @@ void r4k_invalidate_tlb (CPUMIPSState *env, int idx, int use_extra)
 uint8_t **_cheri_tagmem = NULL;
 uint64_t cheri_ntagblks = 0ul;
 
+/*
+ * Tag blocks that no longer hold any tag are freed again by a background
+ * reclaimer.  It marks a candidate block by setting the low bit of its
+ * pointer in _cheri_tagmem, rescans it and only then unpublishes it; the
+ * memory itself is freed after an RCU grace period (all tag accesses from
+ * vCPUs happen inside cpu_exec()'s RCU critical section; the physical
+ * address accessors, which DMA, dump and QMP also use, take rcu_read_lock()
+ * themselves).  Readers simply ignore the mark.  Code storing a non-zero
+ * entry checks after the store that the block is still published,
+ * cancelling a pending reclamation if needed, and redoes the store on a
+ * fresh block if it lost the race; see cheri_tag_block_for_store() and
+ * cheri_tag_block_store_done().  -cheri-no-tag-reclaim disables the thread.
+ */
+#define CAP_TAGBLK_RECLAIMING       ((uintptr_t)1)
+#define CHERI_TAG_RECLAIM_INTERVAL  1000    /* ms */
+#define CHERI_TAG_RECLAIM_BATCH     4096    /* tag blocks per interval */
+
+typedef struct CheriTagBlockFree {
+    struct rcu_head rcu;
+    uint8_t *tagblk;
+} CheriTagBlockFree;
+
+static QemuMutex cheri_tag_reclaim_lock;
+static QemuThread cheri_tag_reclaim_thread;
+
 static inline uint8_t* get_cheri_tagmem(size_t index) {
-    assert(index < cheri_ntagblks && "Tag index out of bounds");
-    return _cheri_tagmem[index];
+    cheri_verify_assert(CHERI_VERIFY_PARANOID,
+                        index < cheri_ntagblks && "Tag index out of bounds");
+    return (uint8_t *)((uintptr_t)atomic_rcu_read(&_cheri_tagmem[index]) &
+                       ~CAP_TAGBLK_RECLAIMING);
+}
+
+static void cheri_tag_block_free_rcu(CheriTagBlockFree *f)
+{
+    g_free(f->tagblk);
+    g_free(f);
+}
+
+/*
+ * Free the all-zero tag blocks among @count blocks starting at @first.
+ * Must be called with cheri_tag_reclaim_lock held.
+ */
+static uint64_t cheri_tag_reclaim_blocks(uint64_t first, uint64_t count)
+{
+    uint64_t blk, end = MIN(first + count, cheri_ntagblks);
+    uint64_t reclaimed = 0;
+
+    for (blk = first; blk < end; blk++) {
+        uint8_t **slot = &_cheri_tagmem[blk];
+        uint8_t *tagblk = atomic_read(slot);
+        uint8_t *marked = (uint8_t *)((uintptr_t)tagblk |
+                                      CAP_TAGBLK_RECLAIMING);
+        CheriTagBlockFree *f;
+
+        if (tagblk == NULL || tagblk == marked ||
+            !buffer_is_zero(tagblk, CAP_TAGBLK_SZ)) {
+            continue;
+        }
+        if (atomic_cmpxchg(slot, tagblk, marked) != tagblk) {
+            continue;
+        }
+        /* pairs with smp_mb() in cheri_tag_block_store_done() */
+        smp_mb();
+        if (!buffer_is_zero(tagblk, CAP_TAGBLK_SZ)) {
+            atomic_cmpxchg(slot, marked, tagblk);
+            continue;
+        }
+        if (atomic_cmpxchg(slot, marked, NULL) != marked) {
+            /* a concurrent store cancelled the reclamation */
+            continue;
+        }
+        f = g_new(CheriTagBlockFree, 1);
+        f->tagblk = tagblk;
+        call_rcu(f, cheri_tag_block_free_rcu, rcu);
+        reclaimed++;
+    }
+    return reclaimed;
+}
+
+static uint64_t cheri_tag_reclaim(uint64_t first, uint64_t count)
+{
+    uint64_t reclaimed;
+
+    qemu_mutex_lock(&cheri_tag_reclaim_lock);
+    reclaimed = cheri_tag_reclaim_blocks(first, count);
+    qemu_mutex_unlock(&cheri_tag_reclaim_lock);
+    return reclaimed;
+}
+
+static void *cheri_tag_reclaim_worker(void *opaque)
+{
+    uint64_t next = 0;
+
+    for (;;) {
+        g_usleep(CHERI_TAG_RECLAIM_INTERVAL * 1000);
+        cheri_tag_reclaim(next, CHERI_TAG_RECLAIM_BATCH);
+        next += CHERI_TAG_RECLAIM_BATCH;
+        if (next >= cheri_ntagblks) {
+            next = 0;
+        }
+    }
+    return NULL;
 }
 
 void cheri_tag_init(uint64_t memory_size)
@@ -1724,6 +1911,13 @@ void cheri_tag_init(uint64_t memory_size)
         error_report("%s: Can't allocated tag memory", __func__);
         exit (-1);
     }
+
+    qemu_mutex_init(&cheri_tag_reclaim_lock);
+    if (cheri_tag_reclaim_enabled) {
+        qemu_thread_create(&cheri_tag_reclaim_thread, "cheri_tag_reclaim",
+                           cheri_tag_reclaim_worker, NULL,
+                           QEMU_THREAD_DETACHED);
+    }
 }
 
 static inline hwaddr v2p_addr(CPUMIPSState *env, target_ulong vaddr, int rw,
@@ -1753,7 +1947,11 @@ static inline void check_tagmem_writable(CPUMIPSState *env, target_ulong vaddr,
 
 static inline ram_addr_t p2r_addr(CPUMIPSState *env, hwaddr addr, MemoryRegion** mrp)
 {
-    hwaddr l;
+    /* Only the byte at addr matters; an uninitialized length could make
+     * the lookup clamp against garbage.  Repeated lookups on the same
+     * few sections are served by the per-thread section cache in exec.c.
+     */
+    hwaddr l = 1;
     MemoryRegion *mr;
     CPUState *cs = CPU(mips_env_get_cpu(env));
 
@@ -1842,12 +2040,18 @@ void cheri_tag_phys_invalidate(ram_addr_t ram_addr, ram_addr_t len)
 
     endaddr = (uint64_t)(ram_addr + len);
 
+    /*
+     * Also called for DMA from device and iothread context (via
+     * invalidate_and_set_dirty()), outside cpu_exec()'s RCU critical
+     * section, so keep the reclaimer from freeing the blocks under us.
+     */
+    rcu_read_lock();
     for(addr = (uint64_t)(ram_addr & ~CAP_MASK); addr < endaddr;
             addr += CAP_SIZE) {
         tag = addr >> CAP_TAG_SHFT;
         tagmem_idx = tag >> CAP_TAGBLK_SHFT;
-        if (tagmem_idx > cheri_ntagblks)
-            return;
+        if (tagmem_idx >= cheri_ntagblks)
+            break;
         tagblk = get_cheri_tagmem(tagmem_idx);
 
         if (tagblk != NULL) {
@@ -1858,10 +2062,148 @@ void cheri_tag_phys_invalidate(ram_addr_t ram_addr, ram_addr_t len)
             tagblk[CAP_TAGBLK_IDX(tag)] = 0;
         }
     }
+    rcu_read_unlock();
 
     /* XXX - linkedflag reset check? */
 }
 
+unsigned cheri_tag_granule_shift(void)
+{
+    return CAP_TAG_SHFT;
+}
+
+/*
+ * Copy the tags covering @len bytes of RAM at @ram_addr into @bitmap, one
+ * bit per capability, LSB first.  Unallocated tag blocks are skipped
+ * without being touched.  Returns false, leaving @bitmap unmodified, if no
+ * tag in the range is set.
+ */
+bool cheri_tag_phys_get_bitmap(ram_addr_t ram_addr, ram_addr_t len,
+                               uint8_t *bitmap)
+{
+    uint64_t first = ram_addr >> CAP_TAG_SHFT;
+    uint64_t end = (ram_addr + len) >> CAP_TAG_SHFT;
+    uint64_t tag = first;
+    bool found = false;
+
+    rcu_read_lock();
+    while (tag < end) {
+        uint64_t blk = tag >> CAP_TAGBLK_SHFT;
+        uint64_t blk_end = MIN((blk + 1) << CAP_TAGBLK_SHFT, end);
+        uint8_t *tagblk;
+
+        if (blk >= cheri_ntagblks) {
+            break;
+        }
+        tagblk = get_cheri_tagmem(blk);
+        if (tagblk == NULL) {
+            tag = blk_end;
+            continue;
+        }
+        for (; tag < blk_end; tag++) {
+            if (tagblk[CAP_TAGBLK_IDX(tag)]) {
+                if (!found) {
+                    memset(bitmap, 0, DIV_ROUND_UP(end - first, 8));
+                    found = true;
+                }
+                bitmap[(tag - first) / 8] |= 1 << ((tag - first) % 8);
+            }
+        }
+    }
+    rcu_read_unlock();
+    return found;
+}
+
+#if !defined(CONFIG_USER_ONLY)
+#define CAP_TAGBLK_COVER    ((uint64_t)1 << (CAP_TAGBLK_SHFT + CAP_TAG_SHFT))
+
+/* Count the tags set in @tagblk for tag numbers [@first, @end). */
+static uint64_t cheri_tagblk_count(const uint8_t *tagblk, uint64_t first,
+                                   uint64_t end)
+{
+    uint64_t tag, count = 0;
+
+    for (tag = first; tag < end; tag++) {
+        count += tagblk[CAP_TAGBLK_IDX(tag)] != 0;
+    }
+    return count;
+}
+
+static int cheri_tag_region_stats(RAMBlock *rb, void *opaque)
+{
+    CheriTagMemoryRegionList ***tail = opaque;
+    CheriTagMemoryRegionList *entry;
+    CheriTagMemoryRegion *region;
+    ram_addr_t offset = qemu_ram_get_offset(rb);
+    ram_addr_t size = qemu_ram_get_used_length(rb);
+    uint64_t tag = offset >> CAP_TAG_SHFT;
+    uint64_t end = (offset + size) >> CAP_TAG_SHFT;
+
+    region = g_new0(CheriTagMemoryRegion, 1);
+    region->name = g_strdup(qemu_ram_get_idstr(rb));
+    region->offset = offset;
+    region->size = size;
+
+    while (tag < end) {
+        uint64_t blk = tag >> CAP_TAGBLK_SHFT;
+        uint64_t blk_end = MIN((blk + 1) << CAP_TAGBLK_SHFT, end);
+        uint8_t *tagblk;
+
+        if (blk >= cheri_ntagblks) {
+            break;
+        }
+        tagblk = get_cheri_tagmem(blk);
+        if (tagblk != NULL) {
+            region->allocated_blocks++;
+            region->tagged_caps += cheri_tagblk_count(tagblk, tag, blk_end);
+        }
+        tag = blk_end;
+    }
+
+    entry = g_new0(CheriTagMemoryRegionList, 1);
+    entry->value = region;
+    **tail = entry;
+    *tail = &entry->next;
+    return 0;
+}
+
+CheriTagMemoryInfo *qmp_query_cheri_tag_memory(bool has_reclaim, bool reclaim,
+                                               Error **errp)
+{
+    CheriTagMemoryInfo *info = g_new0(CheriTagMemoryInfo, 1);
+    CheriTagMemoryRegionList **tail = &info->regions;
+    uint64_t blk;
+
+    if (has_reclaim && reclaim) {
+        info->reclaimed_blocks = cheri_tag_reclaim(0, cheri_ntagblks);
+    }
+
+    rcu_read_lock();
+    info->block_size = CAP_TAGBLK_COVER;
+    info->total_blocks = cheri_ntagblks;
+    for (blk = 0; blk < cheri_ntagblks; blk++) {
+        uint8_t *tagblk = get_cheri_tagmem(blk);
+        uint64_t count;
+
+        if (tagblk == NULL) {
+            continue;
+        }
+        count = cheri_tagblk_count(tagblk, blk << CAP_TAGBLK_SHFT,
+                                   (blk + 1) << CAP_TAGBLK_SHFT);
+        info->allocated_blocks++;
+        info->zero_blocks += count == 0;
+        info->tagged_caps += count;
+    }
+    info->host_bytes = cheri_ntagblks * sizeof(*_cheri_tagmem) +
+                       info->allocated_blocks * CAP_TAGBLK_SZ;
+
+    qemu_ram_foreach_block(cheri_tag_region_stats, &tail);
+    rcu_read_unlock();
+
+    return info;
+}
+#endif /* !CONFIG_USER_ONLY */
+
 static uint8_t *cheri_tag_new_tagblk(uint64_t tag)
 {
     uint8_t *tagblk, *old;
@@ -1879,12 +2221,44 @@ static uint8_t *cheri_tag_new_tagblk(uint64_t tag)
     if (old != NULL) {
         /* Lost the race, free. */
         g_free(tagblk);
-        return old;
+        return (uint8_t *)((uintptr_t)old & ~CAP_TAGBLK_RECLAIMING);
     } else {
         return tagblk;
     }
 }
 
+/* Return the tag block to store a non-zero entry for @tag into. */
+static inline uint8_t *cheri_tag_block_for_store(uint64_t tag)
+{
+    uint8_t *tagblk = get_cheri_tagmem(tag >> CAP_TAGBLK_SHFT);
+
+    if (tagblk == NULL) {
+        /* Allocated a tag block. */
+        tagblk = cheri_tag_new_tagblk(tag);
+    }
+    return tagblk;
+}
+
+/*
+ * Called after storing a non-zero entry into @tagblk.  Cancels a pending
+ * reclamation of the block and returns false if the block was reclaimed
+ * before the store became visible, in which case the store must be redone.
+ */
+static inline bool cheri_tag_block_store_done(uint64_t tag, uint8_t *tagblk)
+{
+    uint8_t **slot = &_cheri_tagmem[tag >> CAP_TAGBLK_SHFT];
+    uint8_t *marked = (uint8_t *)((uintptr_t)tagblk | CAP_TAGBLK_RECLAIMING);
+    uint8_t *cur;
+
+    /* pairs with smp_mb() in cheri_tag_reclaim_blocks() */
+    smp_mb();
+    cur = atomic_read(slot);
+    if (likely(cur == tagblk)) {
+        return true;
+    }
+    return cur == marked && atomic_cmpxchg(slot, marked, tagblk) == marked;
+}
+
 void cheri_tag_set(CPUMIPSState *env, target_ulong vaddr, int reg, uintptr_t pc)
 {
     ram_addr_t ram_addr;
@@ -1909,17 +2283,16 @@ void cheri_tag_set(CPUMIPSState *env, target_ulong vaddr, int reg, uintptr_t pc)
 
     /* Get the tag number and tag block ptr. */
     tag = ram_addr >> CAP_TAG_SHFT;
-    tagblk = get_cheri_tagmem(tag >> CAP_TAGBLK_SHFT);
-
-    if (tagblk == NULL) {
-        /* Allocated a tag block. */
-        tagblk = cheri_tag_new_tagblk(tag);
-    }
+    tagblk = cheri_tag_block_for_store(tag);
     if (unlikely(qemu_loglevel_mask(CPU_LOG_INSTR))) {
         qemu_log("    Cap Tag Write [" RAM_ADDR_FMT "] %d -> 1\n", ram_addr,
                  tagblk[CAP_TAGBLK_IDX(tag)]);
     }
     tagblk[CAP_TAGBLK_IDX(tag)] = 1;
+    while (unlikely(!cheri_tag_block_store_done(tag, tagblk))) {
+        tagblk = cheri_tag_block_for_store(tag);
+        tagblk[CAP_TAGBLK_IDX(tag)] = 1;
+    }
 
     /* Check RAM address to see if the linkedflag needs to be reset. */
     if (ram_addr == p2r_addr(env, env->lladdr, NULL))
@@ -1996,6 +2369,152 @@ int cheri_tag_get_many(CPUMIPSState *env, target_ulong vaddr, int reg,
     }
 }
 
+/*
+ * Whether the capability stored as @bytes (in guest byte order) with tag
+ * memory entry @entry lacks Permit_Global.
+ */
+static bool cheri_mem_cap_is_local(const uint8_t *bytes, const uint8_t *entry)
+{
+#if defined(CHERI_MAGIC128)
+    uint64_t tps = (*(const uint64_t *)entry) >> CAP_TAG_TPS_SHFT;
+
+    return !(((tps >> 1) & CAP_PERMS_ALL) & CAP_PERM_GLOBAL);
+#elif defined(CHERI_128)
+    cap_register_t cap;
+
+    decompress_128cap(ldq_p(bytes), ldq_p(bytes + 8), &cap);
+    return !(cap.cr_perms & CAP_PERM_GLOBAL);
+#else
+    inmemory_chericap256 mem;
+    cap_register_t cap;
+    int i;
+
+    for (i = 0; i < ARRAY_SIZE(mem.u64s); i++) {
+        mem.u64s[i] = ldq_p(bytes + i * 8);
+    }
+    decompress_256cap(mem, &cap, true);
+    return !(cap.cr_perms & CAP_PERM_GLOBAL);
+#endif
+}
+
+/*
+ * Copy @len bytes from @src_vaddr to @dst_vaddr, neither of which may cross a
+ * page boundary. If @preserve_tags is set and both addresses have the same
+ * capability alignment, the tag block entries (including the magic128 side
+ * state) of all capability slots that are fully covered by the copy are
+ * copied as well. All other destination tags are cleared, just like for a
+ * sequence of plain stores.
+ *
+ * The source is translated first and the destination is only resolved as a
+ * capability store if there are actually tags to copy, so that the TLB
+ * exceptions raised are the same as for the equivalent clc/csc loop. All
+ * translations happen before any memory is modified.
+ *
+ * Unless @store_local is set, returns false without writing anything if a
+ * tagged capability that lacks Permit_Global would be copied.
+ */
+bool cheri_copy_with_tags(CPUMIPSState *env, target_ulong dst_vaddr,
+                          target_ulong src_vaddr, uint32_t len,
+                          bool preserve_tags, bool store_local, uintptr_t pc)
+{
+    CPUState *cs = CPU(mips_env_get_cpu(env));
+    uint8_t data[TARGET_PAGE_SIZE];
+    uint8_t entries[(TARGET_PAGE_SIZE / CAP_SIZE) * CAP_TAGBLK_ENTRY_SZ];
+    uint64_t first_slot = 0, nslots = 0;
+    bool have_tags = false;
+    MemoryRegion *mr = NULL;
+    hwaddr src_paddr, dst_paddr;
+    ram_addr_t src_ram, dst_ram;
+    MemTxResult result;
+
+    assert(len > 0 && len <= TARGET_PAGE_SIZE);
+    assert((src_vaddr & TARGET_PAGE_MASK) ==
+           ((src_vaddr + len - 1) & TARGET_PAGE_MASK));
+    assert((dst_vaddr & TARGET_PAGE_MASK) ==
+           ((dst_vaddr + len - 1) & TARGET_PAGE_MASK));
+
+    if (((src_vaddr ^ dst_vaddr) & CAP_MASK) != 0) {
+        preserve_tags = false;
+    }
+    src_paddr = v2p_addr(env, src_vaddr,
+                         preserve_tags ? MMU_DATA_CAP_LOAD : MMU_DATA_LOAD,
+                         0xff, pc);
+    src_ram = p2r_addr(env, src_paddr, NULL);
+    if (preserve_tags && !env->TLB_L && src_ram != -1LL) {
+        uint64_t start = ROUND_UP(src_ram, CAP_SIZE);
+        uint64_t end = (src_ram + len) & ~(uint64_t)CAP_MASK;
+        if (end > start) {
+            uint8_t *tagblk;
+            /* A page always lies within a single tag block. */
+            first_slot = start >> CAP_TAG_SHFT;
+            nslots = (end - start) >> CAP_TAG_SHFT;
+            tagblk = get_cheri_tagmem(first_slot >> CAP_TAGBLK_SHFT);
+            if (tagblk != NULL) {
+                memcpy(entries, &tagblk[CAP_TAGBLK_IDX(first_slot)],
+                       nslots * CAP_TAGBLK_ENTRY_SZ);
+                have_tags = !buffer_is_zero(entries,
+                                            nslots * CAP_TAGBLK_ENTRY_SZ);
+            }
+        }
+    }
+
+    dst_paddr = v2p_addr(env, dst_vaddr,
+                         have_tags ? MMU_DATA_CAP_STORE : MMU_DATA_STORE,
+                         0xff, pc);
+    dst_ram = p2r_addr(env, dst_paddr, &mr);
+    check_tagmem_writable(env, dst_vaddr, dst_paddr, dst_ram, mr, pc);
+
+    result = address_space_read(cs->as, src_paddr, MEMTXATTRS_UNSPECIFIED,
+                                data, len);
+    if (result != MEMTX_OK) {
+        warn_report("%s: error %d reading %u bytes from paddr %" HWADDR_PRIx
+                    "\r", __func__, result, len, src_paddr);
+    }
+    if (have_tags && !store_local) {
+        /* Like csc, refuse to store a tagged local capability. */
+        uint64_t first_off = (first_slot << CAP_TAG_SHFT) - src_ram;
+        uint64_t i;
+
+        for (i = 0; i < nslots; i++) {
+            const uint8_t *entry = &entries[i * CAP_TAGBLK_ENTRY_SZ];
+
+            if (entry[0] &&
+                cheri_mem_cap_is_local(&data[first_off + i * CAP_SIZE],
+                                       entry)) {
+                return false;
+            }
+        }
+    }
+    /* Note: this also clears all destination tags. */
+    result = address_space_write(cs->as, dst_paddr, MEMTXATTRS_UNSPECIFIED,
+                                 data, len);
+    if (result != MEMTX_OK) {
+        warn_report("%s: error %d writing %u bytes to paddr %" HWADDR_PRIx
+                    "\r", __func__, result, len, dst_paddr);
+    }
+
+    if (have_tags && dst_ram != -1LL) {
+        uint64_t dst_slot = (dst_ram + ((first_slot << CAP_TAG_SHFT) - src_ram))
+            >> CAP_TAG_SHFT;
+        uint8_t *tagblk;
+
+        do {
+            tagblk = cheri_tag_block_for_store(dst_slot);
+            memcpy(&tagblk[CAP_TAGBLK_IDX(dst_slot)], entries,
+                   nslots * CAP_TAGBLK_ENTRY_SZ);
+        } while (unlikely(!cheri_tag_block_store_done(dst_slot, tagblk)));
+        qemu_log_mask(CPU_LOG_INSTR, "    Cap Tag Copy [" RAM_ADDR_FMT "] -> ["
+                      RAM_ADDR_FMT "] %" PRIu64 " slots\n",
+                      (ram_addr_t)(first_slot << CAP_TAG_SHFT),
+                      (ram_addr_t)(dst_slot << CAP_TAG_SHFT), nslots);
+    }
+
+    /* Check RAM address to see if the linkedflag needs to be reset. */
+    if (env->lladdr >= dst_paddr && env->lladdr < dst_paddr + len)
+        env->linkedflag = 0;
+    return true;
+}
+
 #ifdef CHERI_MAGIC128
 void cheri_tag_set_m128(CPUMIPSState *env, target_ulong vaddr, int reg,
         uint8_t tagbit, uint64_t tps, uint64_t length, hwaddr *ret_paddr, uintptr_t pc)
@@ -2008,14 +2527,13 @@ void cheri_tag_set_m128(CPUMIPSState *env, target_ulong vaddr, int reg,
     uint8_t *tagblk = cheri_tag_get_block(env, vaddr,
 					  tagbit ? MMU_DATA_CAP_STORE : MMU_DATA_STORE,
 					  reg, 0, pc, ret_paddr, &ram_addr, &tag);
-    if (tagblk == NULL) {
-        /* Allocated a tag block. */
-        tagblk = cheri_tag_new_tagblk(tag);
-    }
-    tagblk64 = (uint64_t *)&tagblk[CAP_TAGBLK_IDX(tag)];
-    *tagblk64 = (tps << CAP_TAG_TPS_SHFT) | tagbit;
-    tagblk64++;
-    *tagblk64 = length;
+    do {
+        tagblk = cheri_tag_block_for_store(tag);
+        tagblk64 = (uint64_t *)&tagblk[CAP_TAGBLK_IDX(tag)];
+        *tagblk64 = (tps << CAP_TAG_TPS_SHFT) | tagbit;
+        tagblk64++;
+        *tagblk64 = length;
+    } while (unlikely(!cheri_tag_block_store_done(tag, tagblk)));
 
 
     /* Check RAM address to see if the linkedflag needs to be reset. */
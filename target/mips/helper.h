@@ -181,7 +181,7 @@ DEF_HELPER_1(mfc0_coreid, tl, env)
 
 #ifdef CONFIG_MIPS_LOG_INSTR
 DEF_HELPER_1(dump_changed_state, void, env)
-DEF_HELPER_2(log_instruction, void, env, i64)
+DEF_HELPER_3(log_instruction, void, env, i64, ptr)
 DEF_HELPER_4(dump_load, void, env, int, tl, tl)
 DEF_HELPER_4(dump_load32, void, env, int, tl, i32)
 DEF_HELPER_2(instr_start, void, env, i64)
@@ -196,7 +196,7 @@ DEF_HELPER_2(magic_library_function, void, env, tl)
 #if defined(TARGET_CHERI)
 DEF_HELPER_2(mtc2_dumpcstate, void, env, tl)
 DEF_HELPER_1(ccheck_btarget, void, env)
-DEF_HELPER_2(ccheck_pc, void, env, i64)
+DEF_HELPER_3(ccheck_pc, void, env, i64, ptr)
 DEF_HELPER_3(ccheck_store, tl, env, tl, i32)
 DEF_HELPER_3(ccheck_store_right, tl, env, tl, i32)
 DEF_HELPER_3(ccheck_load, tl, env, tl, i32)
@@ -268,8 +268,15 @@ DEF_HELPER_4(candaddr, void, env, i32, i32, tl)
 DEF_HELPER_3(ctestsubset, tl, env, i32, i32)
 
 DEF_HELPER_5(cload, tl, env, i32, tl, i32, i32)
-
-DEF_HELPER_5(cstore, tl, env, i32, tl, i32, i32)
+DEF_HELPER_4(cload1, tl, env, i32, tl, i32)
+DEF_HELPER_4(cload2, tl, env, i32, tl, i32)
+DEF_HELPER_4(cload4, tl, env, i32, tl, i32)
+DEF_HELPER_4(cload8, tl, env, i32, tl, i32)
+
+DEF_HELPER_4(cstore1, tl, env, i32, tl, i32)
+DEF_HELPER_4(cstore2, tl, env, i32, tl, i32)
+DEF_HELPER_4(cstore4, tl, env, i32, tl, i32)
+DEF_HELPER_4(cstore8, tl, env, i32, tl, i32)
 
 DEF_HELPER_3(cloadlinked, tl, env, i32, i32)
 
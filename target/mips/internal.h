@@ -94,6 +94,10 @@ int mips_cpu_gdb_write_register(CPUState *cpu, uint8_t *buf, int reg);
 void mips_cpu_do_unaligned_access(CPUState *cpu, vaddr addr,
                                   MMUAccessType access_type,
                                   int mmu_idx, uintptr_t retaddr);
+#if !defined(CONFIG_USER_ONLY) && defined(TARGET_MIPS64)
+int mips_cpu_write_elf64_note(WriteCoreDumpFunction f, CPUState *cs,
+                              int cpuid, void *opaque);
+#endif
 
 #if !defined(CONFIG_USER_ONLY)
 
@@ -127,6 +131,10 @@ struct r4k_tlb_t {
 struct CPUMIPSTLBContext {
     uint32_t nb_tlb;
     uint32_t tlb_in_use;
+    /* Last regular entry r4k_map_address() matched; probed first */
+    uint32_t last_match;
+    /* Bytes mapped by the half of the entry the last match used */
+    target_ulong last_match_size;
     int (*map_address)(struct CPUMIPSState *env, hwaddr *physical, int *prot,
                        target_ulong address, int rw, int access_type);
     void (*helper_tlbwi)(struct CPUMIPSState *env);
@@ -512,9 +520,19 @@ void cheri_dump_state(CPUState *cs, FILE *f, fprintf_function cpu_fprintf, int f
 #define do_raise_c0_exception(env, cause, reg) \
   do_raise_c0_exception_impl(env, cause, reg, _host_return_address)
 
+extern const char *cheri_fault_log_file;
+extern bool cheri_fault_events;
+extern bool afl_coverage_enabled;
+extern int afl_coverage_asid;
+extern uint64_t afl_coverage_start;
+extern uint64_t afl_coverage_end;
+
 static inline QEMU_NORETURN void do_raise_c2_exception_impl(CPUMIPSState *env,
         uint16_t cause, uint16_t reg, uintptr_t pc)
 {
+    if (unlikely(cheri_fault_log_file || cheri_fault_events)) {
+        cheri_log_c2_exception(env, cause, reg, pc);
+    }
     qemu_log_mask(CPU_LOG_INSTR | CPU_LOG_INT, "C2 EXCEPTION: cause=%d(%s)"
        " reg=%d PCC=" PRINT_CAP_FMTSTR " -> host PC: 0x%jx active_tc.PC=0x" TARGET_FMT_plx "\n",
        cause, cp2_fault_causestr[cause], reg, PRINT_CAP_ARGS(&env->active_tc.PCC),
@@ -72,7 +72,7 @@ void helper_check_breakcount(struct CPUMIPSState* env)
 /*
  * Print the instruction to log file.
  */
-void helper_log_instruction(CPUMIPSState *env, target_ulong pc)
+void helper_log_instruction(CPUMIPSState *env, target_ulong pc, void *disas)
 {
     int isa = (env->hflags & MIPS_HFLAG_M16) == 0 ? 0 : (env->insn_flags & ASE_MICROMIPS) ? 1 : 2;
     if (unlikely(qemu_loglevel_mask(CPU_LOG_INSTR))) {
@@ -80,7 +80,10 @@ void helper_log_instruction(CPUMIPSState *env, target_ulong pc)
         CPUState *cs = CPU(cpu);
 
         /* Disassemble and print instruction. */
-        if (isa == 0) {
+        if (disas) {
+            /* Disassembled at translation time */
+            qemu_log("%s", (const char *)disas);
+        } else if (isa == 0) {
             log_target_disas(cs, pc, 4);
         } else {
             log_target_disas(cs, pc, 2);
@@ -5785,6 +5788,9 @@ static struct nop_stats magic_memmove_bytes;
 static struct nop_stats magic_bcopy_bytes;
 
 static struct nop_stats magic_memmove_slowpath;
+#ifdef TARGET_CHERI
+static struct nop_stats magic_cap_memmove_bytes;
+#endif
 
 static inline void print_nop_stats(const char* msg, struct nop_stats* stats) {
     warn_report("%s in kernel mode: %" PRId64 " (%f MB) in %" PRId64 " calls\r", msg,
@@ -5800,6 +5806,9 @@ static void dump_memset_stats_on_exit() {
     print_nop_stats("memmove with magic nop", &magic_memmove_bytes);
     print_nop_stats("bcopy with magic nop", &magic_bcopy_bytes);
     print_nop_stats("memmove/memcpy/bcopy slowpath", &magic_memmove_slowpath);
+#ifdef TARGET_CHERI
+    print_nop_stats("tag-preserving memmove with magic nop", &magic_cap_memmove_bytes);
+#endif
 }
 
 static inline void collect_magic_nop_stats(CPUMIPSState *env, struct nop_stats* stats, target_ulong bytes) {
@@ -6040,6 +6049,94 @@ success:
     return true;
 }
 
+#ifdef TARGET_CHERI
+#define MAGIC_CAP_MEMMOVE_DEST_CAPREG 3
+#define MAGIC_CAP_MEMMOVE_SRC_CAPREG 4
+
+/*
+ * Tag-preserving memmove() for purecap kernels (copyin/copyout, page copies,
+ * pipe buffers): $c3 = dest, $c4 = src, $a0 = length.
+ *
+ * Bounds and permissions of both capabilities are checked once for the whole
+ * range (dest needs Permit_Store and Permit_Store_Capability, src
+ * Permit_Load) and the copy is then done a page at a time on the host,
+ * copying the tag memory along with the data. Tags are only preserved if src
+ * grants Permit_Load_Capability and both buffers have the same capability
+ * alignment. As with csc, copying a tagged local capability traps unless
+ * dest grants Permit_Store_Local_Capability; this is checked before each
+ * page is written.
+ * On a TLB fault $v0 holds the number of bytes already copied and $v1 is
+ * marked as a continuation so that re-executing the magic nop resumes.
+ * On success $c3 is unchanged (the return value) and $v0 is the length.
+ */
+static bool do_magic_cap_memmove(CPUMIPSState *env, uint64_t ra)
+{
+    const cap_register_t *srcp =
+        get_readonly_capreg(&env->active_tc, MAGIC_CAP_MEMMOVE_SRC_CAPREG);
+    const target_ulong original_len = env->active_tc.gpr[MIPS_REGNUM_A0];
+    target_ulong already_written = 0;
+    const bool is_continuation = (env->active_tc.gpr[MIPS_REGNUM_V1] >> 32) == MAGIC_LIBCALL_HELPER_CONTINUATION_FLAG;
+    if (is_continuation) {
+        already_written = env->active_tc.gpr[MIPS_REGNUM_V0];
+        tcg_debug_assert(already_written < original_len);
+    } else if (env->active_tc.gpr[MIPS_REGNUM_V0] != 0) {
+        error_report("ERROR: Attempted to call cap memmove library function "
+                     "with non-zero value in $v0 (0x" TARGET_FMT_lx
+                     ") and continuation flag not set in $v1 (0x" TARGET_FMT_lx
+                     ")!\n", env->active_tc.gpr[MIPS_REGNUM_V0], env->active_tc.gpr[MIPS_REGNUM_V1]);
+        do_raise_exception(env, EXCP_RI, ra);
+    }
+    if (original_len == 0) {
+        goto success;
+    }
+    const target_ulong dest = check_capreg_range(env, MAGIC_CAP_MEMMOVE_DEST_CAPREG,
+        CAP_PERM_STORE | CAP_PERM_STORE_CAP, original_len, ra);
+    const bool store_local = (get_readonly_capreg(&env->active_tc,
+        MAGIC_CAP_MEMMOVE_DEST_CAPREG)->cr_perms & CAP_PERM_STORE_LOCAL) != 0;
+    const target_ulong src = check_capreg_range(env, MAGIC_CAP_MEMMOVE_SRC_CAPREG,
+        CAP_PERM_LOAD, original_len, ra);
+    const bool preserve_tags = (srcp->cr_perms & CAP_PERM_LOAD_CAP) != 0;
+    if (dest == src) {
+        already_written = original_len;
+        goto success;
+    }
+    qemu_log_mask(CPU_LOG_INSTR, "%s: copying 0x" TARGET_FMT_lx " bytes from "
+                  TARGET_FMT_plx " to " TARGET_FMT_plx " (%s tags)\n", __func__,
+                  original_len, src, dest, preserve_tags ? "preserving" : "clearing");
+
+    // Mark this as a continuation in $v1 (so that we continue sensibly if we get a tlb miss and longjump out)
+    env->active_tc.gpr[MIPS_REGNUM_V1] = (MAGIC_LIBCALL_HELPER_CONTINUATION_FLAG << 32) | env->active_tc.gpr[MIPS_REGNUM_V1];
+
+    // Each chunk is buffered in full so only overlap across chunks matters
+    const bool copy_backwards = src < dest && dest < src + original_len;
+    while (already_written < original_len) {
+        target_ulong remaining = original_len - already_written;
+        target_ulong offset, chunk;
+        if (copy_backwards) {
+            chunk = MIN(remaining, ((src + remaining - 1) & ~TARGET_PAGE_MASK) + 1);
+            chunk = MIN(chunk, ((dest + remaining - 1) & ~TARGET_PAGE_MASK) + 1);
+            offset = remaining - chunk;
+        } else {
+            offset = already_written;
+            chunk = adj_len_to_page(remaining, src + offset);
+            chunk = adj_len_to_page(chunk, dest + offset);
+        }
+        // might trap
+        if (!cheri_copy_with_tags(env, dest + offset, src + offset, chunk,
+                                  preserve_tags, store_local, ra)) {
+            do_raise_c2_exception_impl(env, CP2Ca_PERM_ST_LC_CAP,
+                                       MAGIC_CAP_MEMMOVE_DEST_CAPREG, ra);
+        }
+        already_written += chunk;
+        env->active_tc.gpr[MIPS_REGNUM_V0] = already_written;
+    }
+success:
+    tcg_debug_assert(already_written == original_len);
+    env->active_tc.gpr[MIPS_REGNUM_V0] = original_len;
+    return true;
+}
+#endif /* TARGET_CHERI */
+
 static uint8_t ZEROARRAY[TARGET_PAGE_SIZE];
 
 static void do_memset_pattern_hostaddr(void* hostaddr, uint64_t value, uint64_t nitems, unsigned pattern_length, uint64_t ra) {
@@ -6298,6 +6395,7 @@ enum {
     MAGIC_NOP_MEMMOVE_C = 6,
     MAGIC_NOP_BCOPY = 7,
     MAGIC_NOP_U32_MEMSET = 8,
+    MAGIC_NOP_CAP_MEMMOVE = 9,
 };
 
 
@@ -6338,6 +6436,14 @@ void helper_magic_library_function(CPUMIPSState *env, target_ulong which)
         collect_magic_nop_stats(env, &magic_bcopy_bytes, env->active_tc.gpr[MIPS_REGNUM_A2]);
         break;
 
+#ifdef TARGET_CHERI
+    case MAGIC_NOP_CAP_MEMMOVE:
+        if (!do_magic_cap_memmove(env, GETPC()))
+            goto error;
+        collect_magic_nop_stats(env, &magic_cap_memmove_bytes, env->active_tc.gpr[MIPS_REGNUM_A0]);
+        break;
+#endif
+
     case 0xf0:
     case 0xf1:
     {
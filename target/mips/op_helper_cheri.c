@@ -37,9 +37,13 @@
 #include "internal.h"
 #include "qemu/host-utils.h"
 #include "qemu/error-report.h"
+#include "qapi/error.h"
 #include "exec/exec-all.h"
 #include "exec/cpu_ldst.h"
 #include "exec/helper-proto.h"
+#include "qemu/timer.h"
+#include "qemu/cutils.h"
+#include "qapi/qapi-events-target.h"
 
 #ifndef TARGET_CHERI
 #error "This file should only be compiled for CHERI"
@@ -87,6 +91,22 @@ const char *cp2_fault_causestr[] = {
     __attribute__((deprecated("Do not call the helper directly, it will crash at runtime. Call the _impl variant instead"))) helper_##name
 
 
+/*
+ * PC is not saved before every helper call.  Look up the exact one without
+ * restoring the CPU state, since the TB may continue executing afterwards.
+ */
+static inline target_ulong cheri_helper_pc(CPUMIPSState *env, uintptr_t retpc)
+{
+    target_ulong data[TARGET_INSN_START_WORDS];
+
+    if (retpc &&
+        cpu_unwind_state_data(CPU(mips_env_get_cpu(env)), retpc, data)) {
+        return data[0];
+    }
+    return env->active_tc.PC;
+}
+
+
 #ifdef DO_CHERI_STATISTICS
 
 struct bounds_bucket {
@@ -158,19 +178,187 @@ static inline int out_of_bounds_stat_index(uint64_t howmuch) {
     return ARRAY_SIZE(bounds_buckets); // more than 64MB
 }
 
-#define check_out_of_bounds_stat(env, op, capreg) do { \
+/*
+ * Per-(PC, ASID) aggregation of bounds events. The global buckets above only
+ * say how often something happened; this table says where, so the few call
+ * sites responsible for most of the imprecision can be found without
+ * enabling the (very verbose) BOUNDS: log.
+ */
+typedef enum {
+    BOUNDS_SITE_OUT_OF_BOUNDS,
+    BOUNDS_SITE_UNREPRESENTABLE,
+    BOUNDS_SITE_IMPRECISE_SETBOUNDS,
+} bounds_site_event_t;
+
+typedef struct bounds_site {
+    uint64_t pc;
+    uint8_t asid;
+    uint64_t out_of_bounds; /* excluding one past the end */
+    uint64_t unrepresentable;
+    uint64_t imprecise_setbounds;
+    /* how far out of bounds the cursor ended up */
+    uint64_t out_of_bounds_by[ARRAY_SIZE(bounds_buckets) + 1];
+    /* requested length of imprecise csetbounds */
+    uint64_t imprecise_length[ARRAY_SIZE(bounds_buckets) + 1];
+} bounds_site_t;
+
+#define BOUNDS_SITES_DUMP_MAX 64
+
+static GHashTable *bounds_sites;
+static QemuSpin bounds_sites_lock;
+
+static guint bounds_site_hash(gconstpointer key)
+{
+    const bounds_site_t *site = key;
+
+    return g_int64_hash(&site->pc) ^ site->asid;
+}
+
+static gboolean bounds_site_equal(gconstpointer a, gconstpointer b)
+{
+    const bounds_site_t *sa = a, *sb = b;
+
+    return sa->pc == sb->pc && sa->asid == sb->asid;
+}
+
+static void bounds_site_record(CPUMIPSState *env, bounds_site_event_t event,
+                               uint64_t size, uintptr_t retpc)
+{
+    bounds_site_t key, *site;
+
+    key.pc = cheri_helper_pc(env, retpc);
+    key.asid = env->CP0_EntryHi & 0xFF;
+
+    qemu_spin_lock(&bounds_sites_lock);
+    if (!bounds_sites) {
+        bounds_sites = g_hash_table_new_full(bounds_site_hash,
+                                             bounds_site_equal, NULL, g_free);
+    }
+    site = g_hash_table_lookup(bounds_sites, &key);
+    if (!site) {
+        site = g_new0(bounds_site_t, 1);
+        site->pc = key.pc;
+        site->asid = key.asid;
+        g_hash_table_insert(bounds_sites, site, site);
+    }
+    switch (event) {
+    case BOUNDS_SITE_OUT_OF_BOUNDS:
+        site->out_of_bounds++;
+        site->out_of_bounds_by[out_of_bounds_stat_index(size)]++;
+        break;
+    case BOUNDS_SITE_UNREPRESENTABLE:
+        site->unrepresentable++;
+        break;
+    case BOUNDS_SITE_IMPRECISE_SETBOUNDS:
+        site->imprecise_setbounds++;
+        site->imprecise_length[out_of_bounds_stat_index(size)]++;
+        break;
+    }
+    qemu_spin_unlock(&bounds_sites_lock);
+}
+
+static inline uint64_t bounds_site_total(const bounds_site_t *site)
+{
+    return site->out_of_bounds + site->unrepresentable +
+           site->imprecise_setbounds;
+}
+
+static gint bounds_site_compare(gconstpointer a, gconstpointer b)
+{
+    uint64_t ta = bounds_site_total(*(bounds_site_t * const *)a);
+    uint64_t tb = bounds_site_total(*(bounds_site_t * const *)b);
+
+    return ta < tb ? 1 : ta > tb ? -1 : 0;
+}
+
+static void dump_bounds_histogram(FILE *f, fprintf_function cpu_fprintf,
+                                  const char *name, const uint64_t *buckets)
+{
+    int i;
+
+    cpu_fprintf(f, "    %s:", name);
+    for (i = 0; i < ARRAY_SIZE(bounds_buckets); i++) {
+        if (buckets[i]) {
+            cpu_fprintf(f, " <=%s:%" PRIu64, bounds_buckets[i].name,
+                        buckets[i]);
+        }
+    }
+    if (buckets[ARRAY_SIZE(bounds_buckets)]) {
+        cpu_fprintf(f, " >%s:%" PRIu64,
+                    bounds_buckets[ARRAY_SIZE(bounds_buckets) - 1].name,
+                    buckets[ARRAY_SIZE(bounds_buckets)]);
+    }
+    cpu_fprintf(f, "\n");
+}
+
+static void dump_bounds_sites(FILE *f, fprintf_function cpu_fprintf)
+{
+    GPtrArray *sites;
+    GHashTableIter iter;
+    gpointer value;
+    guint i;
+
+    qemu_spin_lock(&bounds_sites_lock);
+    if (!bounds_sites) {
+        qemu_spin_unlock(&bounds_sites_lock);
+        return;
+    }
+    sites = g_ptr_array_sized_new(g_hash_table_size(bounds_sites));
+    g_hash_table_iter_init(&iter, bounds_sites);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        bounds_site_t *copy = g_memdup(value, sizeof(bounds_site_t));
+        g_ptr_array_add(sites, copy);
+    }
+    qemu_spin_unlock(&bounds_sites_lock);
+
+    g_ptr_array_sort(sites, bounds_site_compare);
+    cpu_fprintf(f, "Bounds events by PC (%u sites, top %u):\n", sites->len,
+                MIN(sites->len, BOUNDS_SITES_DUMP_MAX));
+    cpu_fprintf(f, "  %-18s %4s %12s %12s %12s\n", "PC", "ASID",
+                "OutOfBounds", "Unrep", "Imprecise");
+    for (i = 0; i < sites->len && i < BOUNDS_SITES_DUMP_MAX; i++) {
+        const bounds_site_t *site = g_ptr_array_index(sites, i);
+
+        cpu_fprintf(f, "  0x%016" PRIx64 " %4u %12" PRIu64 " %12" PRIu64
+                    " %12" PRIu64 "\n", site->pc, site->asid,
+                    site->out_of_bounds, site->unrepresentable,
+                    site->imprecise_setbounds);
+        if (site->out_of_bounds) {
+            dump_bounds_histogram(f, cpu_fprintf, "out of bounds by",
+                                  site->out_of_bounds_by);
+        }
+        if (site->imprecise_setbounds) {
+            dump_bounds_histogram(f, cpu_fprintf, "imprecise length",
+                                  site->imprecise_length);
+        }
+    }
+    for (i = 0; i < sites->len; i++) {
+        g_free(g_ptr_array_index(sites, i));
+    }
+    g_ptr_array_free(sites, true);
+}
+
+#define check_out_of_bounds_stat(env, op, capreg, retpc) do { \
     int64_t howmuch = _howmuch_out_of_bounds(env, capreg, #op); \
     if (howmuch > 0) { \
         stat_num_##op##_after_bounds[out_of_bounds_stat_index(howmuch)]++; \
     } else if (howmuch < 0) { \
         stat_num_##op##_before_bounds[out_of_bounds_stat_index(llabs(howmuch))]++; \
     } \
+    /* one past the end is fine, don't attribute it to a site */ \
+    if (howmuch > 1 || howmuch < 0) { \
+        bounds_site_record(env, BOUNDS_SITE_OUT_OF_BOUNDS, llabs(howmuch), retpc); \
+    } \
 } while (0)
 
+#define imprecise_setbounds_stat(env, length, retpc) \
+    bounds_site_record(env, BOUNDS_SITE_IMPRECISE_SETBOUNDS, length, retpc)
+
 // TODO: count how far it was out of bounds for this stat
 #define became_unrepresentable(env, reg, operation, retpc) do { \
     /* unrepresentable implies more than one out of bounds: */ \
     stat_num_##operation##_out_of_bounds_unrep++; \
+    bounds_site_record(env, BOUNDS_SITE_UNREPRESENTABLE, 0, retpc); \
     qemu_log_mask(CPU_LOG_INSTR | CPU_LOG_CHERI_BOUNDS, \
          "BOUNDS: Unrepresentable capability created using %s, pc=%016" PRIx64 " ASID=%u\n", \
         #operation, cap_get_cursor(&env->active_tc.PCC), (unsigned)(env->CP0_EntryHi & 0xFF)); \
@@ -223,7 +411,8 @@ static void dump_out_of_bounds_stats(FILE* f, fprintf_function cpu_fprintf,
 #else /* !defined(DO_CHERI_STATISTICS) */
 
 // Don't collect any statistics by default (it slows down QEMU)
-#define check_out_of_bounds_stat(env, op, capreg) do { } while (0)
+#define check_out_of_bounds_stat(env, op, capreg, retpc) do { } while (0)
+#define imprecise_setbounds_stat(env, length, retpc) do { } while (0)
 #define became_unrepresentable(env, reg, operation, retpc) _became_unrepresentable(env, reg, retpc)
 
 #endif /* DO_CHERI_STATISTICS */
@@ -244,9 +433,162 @@ void cheri_cpu_dump_statistics(CPUState *cs, FILE*f,
     DUMP_CHERI_STAT(cgetpccsetoffset, "CGetPCCSetOffset");
     DUMP_CHERI_STAT(cfromptr, "CFromPtr");
 #undef DUMP_CHERI_STAT
+    dump_bounds_sites(f, cpu_fprintf);
 #endif
 }
 
+/*
+ * Capability exception event stream (-cheri-fault-log / -cheri-fault-events).
+ * Records are collected in a per-vCPU buffer and only written out once it
+ * fills up (or at exit), so that fault-heavy workloads such as fuzzing
+ * campaigns don't pay for a write() per exception.  The buffers are
+ * protected by fault_log_lock, since the exit handler flushes them while
+ * other vCPUs may still be running.
+ */
+static QemuMutex fault_log_lock;
+static FILE *fault_log_fp;
+
+static void __attribute__((constructor)) cheri_fault_log_init(void)
+{
+    qemu_mutex_init(&fault_log_lock);
+}
+
+/* Stop logging after a write error rather than leave a silent gap */
+static void cheri_fault_log_close_locked(bool failed)
+{
+    if (fclose(fault_log_fp) != 0 || failed) {
+        error_report("Error writing CHERI fault log %s: %s",
+                     cheri_fault_log_file, strerror(errno));
+    }
+    fault_log_fp = NULL;
+}
+
+static void cheri_fault_log_flush_locked(CPUMIPSState *env)
+{
+    if (fault_log_fp && env->fault_log_count &&
+        fwrite(env->fault_log, sizeof(cheri_fault_record_t),
+               env->fault_log_count, fault_log_fp) != env->fault_log_count) {
+        cheri_fault_log_close_locked(true);
+    }
+    env->fault_log_count = 0;
+}
+
+static void cheri_fault_log_at_exit(void)
+{
+    CPUState *cs;
+
+    qemu_mutex_lock(&fault_log_lock);
+    CPU_FOREACH(cs) {
+        cheri_fault_log_flush_locked(&MIPS_CPU(cs)->env);
+    }
+    if (fault_log_fp) {
+        cheri_fault_log_close_locked(false);
+    }
+    qemu_mutex_unlock(&fault_log_lock);
+}
+
+/*
+ * Called when the first vCPU is realized, so that an unwritable file is
+ * reported at startup and the records still buffered in every vCPU are
+ * written out at exit even if none of the buffers ever filled up.
+ */
+bool cheri_fault_log_open(Error **errp)
+{
+    char header[sizeof(cheri_fault_record_t)] = { 0 };
+    bool ok = true;
+
+    qemu_mutex_lock(&fault_log_lock);
+    if (!fault_log_fp) {
+        fault_log_fp = fopen(cheri_fault_log_file, "wb");
+        if (fault_log_fp) {
+            pstrcpy(header, sizeof(header), CHERI_FAULT_LOG_MAGIC);
+            if (fwrite(header, sizeof(header), 1, fault_log_fp) == 1 &&
+                fflush(fault_log_fp) == 0) {
+                atexit(cheri_fault_log_at_exit);
+            } else {
+                error_setg_errno(errp, errno,
+                                 "Could not write CHERI fault log %s",
+                                 cheri_fault_log_file);
+                fclose(fault_log_fp);
+                fault_log_fp = NULL;
+                ok = false;
+            }
+        } else {
+            error_setg_errno(errp, errno, "Could not open CHERI fault log %s",
+                             cheri_fault_log_file);
+            ok = false;
+        }
+    }
+    qemu_mutex_unlock(&fault_log_lock);
+    return ok;
+}
+
+static void cheri_fault_log_record(CPUMIPSState *env, CPUState *cs,
+                                   target_ulong pc, uint16_t cause,
+                                   uint16_t reg, uint8_t asid)
+{
+    cheri_fault_record_t *rec;
+    const cap_register_t *cr = NULL;
+
+    qemu_mutex_lock(&fault_log_lock);
+    if (!env->fault_log) {
+        env->fault_log = g_new(cheri_fault_record_t, CHERI_FAULT_LOG_BUFSZ);
+    }
+    rec = &env->fault_log[env->fault_log_count];
+    memset(rec, 0, sizeof(*rec));
+    rec->timestamp = tswap64(qemu_clock_get_ns(QEMU_CLOCK_HOST));
+    rec->pc = tswap64(pc);
+    rec->thread = tswap16(cs->cpu_index);
+    rec->asid = asid;
+    rec->cause = cause;
+    rec->reg = reg;
+
+    if (reg < 32) {
+        cr = get_readonly_capreg(&env->active_tc, reg);
+    } else if (reg == 0xff) {
+        cr = &env->active_tc.PCC;
+    }
+    if (cr) {
+        rec->cap_tag = cr->cr_tag;
+        rec->cap_sealed = cap_is_sealed_with_type(cr) || cap_is_sealed_entry(cr);
+        rec->cap_perms = tswap32(((cr->cr_uperms & CAP_UPERMS_ALL) << CAP_UPERMS_SHFT) |
+                                 (cr->cr_perms & CAP_PERMS_ALL));
+        rec->cap_otype = tswap32(cr->cr_otype);
+        rec->cap_base = tswap64(cr->cr_base);
+        rec->cap_length = tswap64(cap_get_length(cr));
+        rec->cap_offset = tswap64(cap_get_offset(cr));
+    }
+
+    if (++env->fault_log_count == CHERI_FAULT_LOG_BUFSZ) {
+        cheri_fault_log_flush_locked(env);
+    }
+    qemu_mutex_unlock(&fault_log_lock);
+}
+
+void cheri_log_c2_exception(CPUMIPSState *env, uint16_t cause, uint16_t reg,
+                            uintptr_t retpc)
+{
+    CPUState *cs = CPU(mips_env_get_cpu(env));
+    uint8_t asid = env->CP0_EntryHi & 0xFF;
+    target_ulong pc = cheri_helper_pc(env, retpc);
+
+    if (cheri_fault_log_file) {
+        cheri_fault_log_record(env, cs, pc, cause, reg, asid);
+    }
+    if (cheri_fault_events) {
+        bool locked = qemu_mutex_iothread_locked();
+
+        if (!locked) {
+            qemu_mutex_lock_iothread();
+        }
+        qapi_event_send_cheri_capability_fault(cs->cpu_index, pc, asid,
+                                               cause, reg);
+        if (!locked) {
+            qemu_mutex_unlock_iothread();
+        }
+    }
+}
+
 /**
  * LLM: utility funcs to check types of two capabilities
  * */
@@ -689,7 +1031,7 @@ void CHERI_HELPER_IMPL(cfromptr)(CPUMIPSState *env, uint32_t cd, uint32_t cb,
             became_unrepresentable(env, cd, cfromptr, _host_return_address);
             cap_mark_unrepresentable(cbp->cr_base + rt, &result);
         } else {
-            check_out_of_bounds_stat(env, cfromptr, &result);
+            check_out_of_bounds_stat(env, cfromptr, &result, _host_return_address);
         }
         update_capreg(&env->active_tc, cd, &result);
     }
@@ -800,7 +1142,7 @@ void CHERI_HELPER_IMPL(cgetpccsetoffset)(CPUMIPSState *env, uint32_t cd, target_
             became_unrepresentable(env, cd, cgetpccsetoffset, _host_return_address);
         cap_mark_unrepresentable(pccp->cr_base + rs, &result);
     } else {
-        check_out_of_bounds_stat(env, cgetpccsetoffset, &result);
+        check_out_of_bounds_stat(env, cgetpccsetoffset, &result, _host_return_address);
         /* Note that the offset(cursor) is updated by ccheck_pcc */
     }
     update_capreg(&env->active_tc, cd, &result);
@@ -885,7 +1227,7 @@ static void cincoffset_impl(CPUMIPSState *env, uint32_t cd, uint32_t cb, target_
             }
             cap_mark_unrepresentable(cbp->cr_base + cb_offset_plus_rt, &result);
         } else {
-            check_out_of_bounds_stat(env, cincoffset, &result);
+            check_out_of_bounds_stat(env, cincoffset, &result, retpc);
         }
         update_capreg(&env->active_tc, cd, &result);
     }
@@ -1286,13 +1628,16 @@ static void do_setbounds(bool must_be_exact, CPUMIPSState *env, uint32_t cd,
          * representable.
          */
         const bool exact = cc128_setbounds(&result, cursor, new_top);
-        if (!exact)
+        if (!exact) {
             env->statcounters_imprecise_setbounds++;
+            imprecise_setbounds_stat(env, length, _host_return_address);
+        }
         if (must_be_exact && !exact) {
             do_raise_c2_exception(env, CP2Ca_INEXACT, cb);
             return;
         }
-        assert(cc128_is_representable_cap_exact(&result) && "CSetBounds must create a representable capability");
+        cheri_verify_assert(CHERI_VERIFY_PARANOID,
+            cc128_is_representable_cap_exact(&result) && "CSetBounds must create a representable capability");
 #else
         (void)must_be_exact;
         /* Capabilities are precise -> can just set the values here */
@@ -1300,9 +1645,9 @@ static void do_setbounds(bool must_be_exact, CPUMIPSState *env, uint32_t cd,
         result._cr_top = new_top;
         result.cr_offset = 0;
 #endif
-        assert(result.cr_base >= cbp->cr_base && "CSetBounds broke monotonicity (base)");
-        assert(cap_get_length65(&result) <= cap_get_length65(cbp) && "CSetBounds broke monotonicity (length)");
-        assert(cap_get_top65(&result) <= cap_get_top65(cbp) && "CSetBounds broke monotonicity (top)");
+        cheri_verify_assert(CHERI_VERIFY_PARANOID, result.cr_base >= cbp->cr_base && "CSetBounds broke monotonicity (base)");
+        cheri_verify_assert(CHERI_VERIFY_PARANOID, cap_get_length65(&result) <= cap_get_length65(cbp) && "CSetBounds broke monotonicity (length)");
+        cheri_verify_assert(CHERI_VERIFY_PARANOID, cap_get_top65(&result) <= cap_get_top65(cbp) && "CSetBounds broke monotonicity (top)");
         update_capreg(&env->active_tc, cd, &result);
     }
 }
@@ -1434,7 +1779,7 @@ void CHERI_HELPER_IMPL(csetoffset)(CPUMIPSState *env, uint32_t cd, uint32_t cb,
                 became_unrepresentable(env, cd, csetoffset, _host_return_address);
             cap_mark_unrepresentable(cbp->cr_base + rt, &result);
         } else {
-            check_out_of_bounds_stat(env, csetoffset, &result);
+            check_out_of_bounds_stat(env, csetoffset, &result, _host_return_address);
         }
         update_capreg(&env->active_tc, cd, &result);
     }
@@ -1720,11 +2065,15 @@ target_ulong CHERI_HELPER_IMPL(ctestsubset)(CPUMIPSState *env, uint32_t cb, uint
 
 /*
  * Load Via Capability Register
+ *
+ * cload_impl()/cstore_impl() are always inlined so that the per-size
+ * helpers below get the alignment and bounds checks folded for their
+ * constant access size.
  */
-target_ulong CHERI_HELPER_IMPL(cload)(CPUMIPSState *env, uint32_t cb, target_ulong rt,
-        uint32_t offset, uint32_t size)
+static inline __attribute__((always_inline)) target_ulong
+cload_impl(CPUMIPSState *env, uint32_t cb, target_ulong rt, uint32_t offset,
+           uint32_t size, uintptr_t _host_return_address)
 {
-    GET_HOST_RETPC();
     // CL[BHWD][U] traps on cbp == NULL so we use reg0 as $ddc to save encoding
     // space and increase code density since loading relative to $ddc is common
     // in the hybrid ABI (and also for backwards compat with old binaries).
@@ -1858,10 +2207,10 @@ target_ulong CHERI_HELPER_IMPL(cstorecond)(CPUMIPSState *env, uint32_t cb, uint3
 /*
  * Store Via Capability Register
  */
-target_ulong CHERI_HELPER_IMPL(cstore)(CPUMIPSState *env, uint32_t cb, target_ulong rt,
-        uint32_t offset, uint32_t size)
+static inline __attribute__((always_inline)) target_ulong
+cstore_impl(CPUMIPSState *env, uint32_t cb, target_ulong rt, uint32_t offset,
+            uint32_t size, uintptr_t _host_return_address)
 {
-    GET_HOST_RETPC();
     // CS[BHWD][U] traps on cbp == NULL so we use reg0 as $ddc to save encoding
     // space and increase code density since storing relative to $ddc is common
     // in the hybrid ABI (and also for backwards compat with old binaries).
@@ -1932,6 +2281,35 @@ target_ulong CHERI_HELPER_IMPL(cstore)(CPUMIPSState *env, uint32_t cb, target_ul
     return 0;
 }
 
+target_ulong CHERI_HELPER_IMPL(cload)(CPUMIPSState *env, uint32_t cb, target_ulong rt,
+        uint32_t offset, uint32_t size)
+{
+    return cload_impl(env, cb, rt, offset, size, GETPC());
+}
+
+/*
+ * Size-specialized variants of cload/cstore for CL[BHWD][U] and CS[BHWD].
+ * The sign extension of loads is done by the TCG load itself, so only the
+ * access size matters here.
+ */
+#define DEFINE_CLOAD_CSTORE_HELPERS(size)                                    \
+target_ulong CHERI_HELPER_IMPL(cload##size)(CPUMIPSState *env, uint32_t cb,  \
+        target_ulong rt, uint32_t offset)                                    \
+{                                                                            \
+    return cload_impl(env, cb, rt, offset, size, GETPC());                   \
+}                                                                            \
+                                                                             \
+target_ulong CHERI_HELPER_IMPL(cstore##size)(CPUMIPSState *env, uint32_t cb, \
+        target_ulong rt, uint32_t offset)                                    \
+{                                                                            \
+    return cstore_impl(env, cb, rt, offset, size, GETPC());                  \
+}
+
+DEFINE_CLOAD_CSTORE_HELPERS(1)
+DEFINE_CLOAD_CSTORE_HELPERS(2)
+DEFINE_CLOAD_CSTORE_HELPERS(4)
+DEFINE_CLOAD_CSTORE_HELPERS(8)
+
 static target_ulong get_clc_addr(CPUMIPSState *env, uint32_t cd, uint32_t cb,
         target_ulong rt, uint32_t offset, uintptr_t _host_return_address)
 {
@@ -2555,6 +2933,55 @@ static inline void dump_cap_store_length(uint64_t length)
 
 #endif // CONFIG_MIPS_LOG_INSTR
 
+/*
+ * Move a whole 256-bit capability between guest memory and @buf.
+ *
+ * Capabilities are always CHERI_CAP_SIZE aligned so they can never cross a
+ * page boundary. If the softmmu TLB already holds a direct RAM mapping for
+ * the page we copy all 32 bytes with a single memcpy() (which the compiler
+ * turns into one or two vector moves) and byteswap in place instead of going
+ * through the TLB lookup for each of the four 64-bit words. Otherwise (TLB
+ * miss, I/O memory, notdirty or watchpoint pages) fall back to the normal
+ * per-word accessors which also take care of filling the TLB and faulting.
+ */
+static inline void load_cap256_bytes(CPUMIPSState *env, target_ulong vaddr,
+                                     inmemory_chericap256 *buf, uintptr_t retpc)
+{
+    const void *host = tlb_vaddr_to_host(env, vaddr, MMU_DATA_LOAD,
+                                         cpu_mmu_index(env, false));
+    if (likely(host)) {
+        memcpy(buf, host, sizeof(*buf));
+        for (int i = 0; i < ARRAY_SIZE(buf->u64s); i++) {
+            buf->u64s[i] = tswap64(buf->u64s[i]);
+        }
+        return;
+    }
+    buf->u64s[0] = cpu_ldq_data_ra(env, vaddr + 0, retpc); /* perms+otype */
+    buf->u64s[1] = cpu_ldq_data_ra(env, vaddr + 8, retpc); /* cursor */
+    buf->u64s[2] = cpu_ldq_data_ra(env, vaddr + 16, retpc); /* base */
+    buf->u64s[3] = cpu_ldq_data_ra(env, vaddr + 24, retpc); /* length */
+}
+
+static inline void store_cap256_bytes(CPUMIPSState *env, target_ulong vaddr,
+                                      const inmemory_chericap256 *buf,
+                                      uintptr_t retpc)
+{
+    void *host = tlb_vaddr_to_host(env, vaddr, MMU_DATA_STORE,
+                                   cpu_mmu_index(env, false));
+    if (likely(host)) {
+        inmemory_chericap256 swapped;
+        for (int i = 0; i < ARRAY_SIZE(buf->u64s); i++) {
+            swapped.u64s[i] = tswap64(buf->u64s[i]);
+        }
+        memcpy(host, &swapped, sizeof(swapped));
+        return;
+    }
+    cpu_stq_data_ra(env, vaddr + 0, buf->u64s[0], retpc);
+    cpu_stq_data_ra(env, vaddr + 8, buf->u64s[1], retpc);
+    cpu_stq_data_ra(env, vaddr + 16, buf->u64s[2], retpc);
+    cpu_stq_data_ra(env, vaddr + 24, buf->u64s[3], retpc);
+}
+
 static void load_cap_from_memory(CPUMIPSState *env, uint32_t cd, uint32_t cb,
                                  target_ulong vaddr, target_ulong retpc, bool linked)
 {
@@ -2563,13 +2990,9 @@ static void load_cap_from_memory(CPUMIPSState *env, uint32_t cd, uint32_t cb,
     // Since this is used by cl* we need to treat cb == 0 as $ddc
     const cap_register_t *cbp = get_capreg_0_is_ddc(&env->active_tc, cb);
 
-    // TODO: do one physical translation and then use that to speed up tag read
     /* Load otype and perms from memory (might trap on load) */
     inmemory_chericap256 mem_buffer;
-    mem_buffer.u64s[0] = cpu_ldq_data_ra(env, vaddr + 0, retpc); /* perms+otype */
-    mem_buffer.u64s[1] = cpu_ldq_data_ra(env, vaddr + 8, retpc); /* cursor */
-    mem_buffer.u64s[2] = cpu_ldq_data_ra(env, vaddr + 16, retpc); /* base */
-    mem_buffer.u64s[3] = cpu_ldq_data_ra(env, vaddr + 24, retpc); /* length */
+    load_cap256_bytes(env, vaddr, &mem_buffer, retpc);
 
     target_ulong tag = cheri_tag_get(env, vaddr, cd, linked ? &env->lladdr : NULL, retpc);
     tag = clear_tag_if_no_loadcap(env, tag, cbp);
@@ -2651,10 +3074,7 @@ static void store_cap_to_memory(CPUMIPSState *env, uint32_t cs,
         cheri_tag_invalidate(env, vaddr, CHERI_CAP_SIZE, retpc);
     }
 
-    cpu_stq_data_ra(env, vaddr + 0, mem_buffer.u64s[0], retpc);
-    cpu_stq_data_ra(env, vaddr + 8, mem_buffer.u64s[1], retpc);
-    cpu_stq_data_ra(env, vaddr + 16, mem_buffer.u64s[2], retpc);
-    cpu_stq_data_ra(env, vaddr + 24, mem_buffer.u64s[3], retpc);
+    store_cap256_bytes(env, vaddr, &mem_buffer, retpc);
 
 #ifdef CONFIG_MIPS_LOG_INSTR
     /* Log memory cap write, if needed. */
@@ -2682,7 +3102,8 @@ void CHERI_HELPER_IMPL(ccheck_btarget)(CPUMIPSState *env)
     check_cap(env, &env->active_tc.PCC, CAP_PERM_EXECUTE, env->btarget, 0xff, 4, /*instavail=*/false, GETPC());
 }
 
-void CHERI_HELPER_IMPL(ccheck_pc)(CPUMIPSState *env, uint64_t next_pc)
+void CHERI_HELPER_IMPL(ccheck_pc)(CPUMIPSState *env, uint64_t next_pc,
+                                  void *disas)
 {
     cap_register_t *pcc = &env->active_tc.PCC;
 
@@ -2712,7 +3133,7 @@ void CHERI_HELPER_IMPL(ccheck_pc)(CPUMIPSState *env, uint64_t next_pc)
 #ifdef CONFIG_MIPS_LOG_INSTR
     // Finally, log the instruction that will be executed next
     if (unlikely(should_log_instr)) {
-        helper_log_instruction(env, next_pc);
+        helper_log_instruction(env, next_pc, disas);
     }
 #endif
 }
@@ -2768,6 +3189,38 @@ target_ulong check_ddc(CPUMIPSState *env, uint32_t perm, uint64_t ddc_offset, ui
     return addr;
 }
 
+/*
+ * Check that capability register @regnum authorizes a @len byte access at its
+ * cursor that needs all of @perms. Unlike check_cap() this reports the same
+ * cause as the matching load/store instruction for every permission bit and
+ * allows lengths larger than 4GB.
+ */
+target_ulong check_capreg_range(CPUMIPSState *env, uint16_t regnum,
+        uint32_t perms, uint64_t len, uintptr_t _host_return_address)
+{
+    const cap_register_t *cr = get_readonly_capreg(&env->active_tc, regnum);
+    uint64_t addr = cap_get_cursor(cr);
+
+    if (!cr->cr_tag) {
+        do_raise_c2_exception(env, CP2Ca_TAG, regnum);
+    } else if (is_cap_sealed(cr)) {
+        do_raise_c2_exception(env, CP2Ca_SEAL, regnum);
+    } else if ((perms & CAP_PERM_LOAD) && !(cr->cr_perms & CAP_PERM_LOAD)) {
+        do_raise_c2_exception(env, CP2Ca_PERM_LD, regnum);
+    } else if ((perms & CAP_PERM_LOAD_CAP) && !(cr->cr_perms & CAP_PERM_LOAD_CAP)) {
+        do_raise_c2_exception(env, CP2Ca_PERM_LD_CAP, regnum);
+    } else if ((perms & CAP_PERM_STORE) && !(cr->cr_perms & CAP_PERM_STORE)) {
+        do_raise_c2_exception(env, CP2Ca_PERM_ST, regnum);
+    } else if ((perms & CAP_PERM_STORE_CAP) && !(cr->cr_perms & CAP_PERM_STORE_CAP)) {
+        do_raise_c2_exception(env, CP2Ca_PERM_ST_CAP, regnum);
+    } else if ((perms & CAP_PERM_STORE_LOCAL) && !(cr->cr_perms & CAP_PERM_STORE_LOCAL)) {
+        do_raise_c2_exception(env, CP2Ca_PERM_ST_LC_CAP, regnum);
+    } else if (!cap_is_in_bounds(cr, addr, len)) {
+        do_raise_c2_exception(env, CP2Ca_LENGTH, regnum);
+    }
+    return addr;
+}
+
 target_ulong CHERI_HELPER_IMPL(ccheck_store)(CPUMIPSState *env, target_ulong offset, uint32_t len)
 {
     return check_ddc(env, CAP_PERM_STORE, offset, len, /*instavail=*/true, GETPC());
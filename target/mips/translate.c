@@ -38,6 +38,9 @@
 #include "trace-tcg.h"
 #include "exec/translator.h"
 #include "exec/log.h"
+#ifdef CONFIG_POSIX
+#include <sys/shm.h>
+#endif
 
 #define MIPS_DEBUG_DISAS 0
 
@@ -2766,6 +2769,7 @@ typedef struct DisasContext {
     int mem_idx;
     TCGMemOp default_tcg_memop_mask;
     uint32_t hflags, saved_hflags;
+    bool log_instr; /* MIPS_TBFLAG_LOG_INSTR */
     target_ulong btarget;
     bool ulri;
     int kscrexist;
@@ -3113,6 +3117,43 @@ static inline void gen_op_addr_add (DisasContext *ctx, TCGv ret, TCGv arg0, TCGv
 #endif
 }
 
+#ifdef CONFIG_MIPS_LOG_INSTR
+/*
+ * With -d instr every executed instruction is disassembled. Do that once at
+ * translation time instead and pass the text to the logging helper. The
+ * strings are referenced from generated code, so they can only be released
+ * once a tb_flush() has discarded every TB translated before it.
+ */
+static QemuMutex disas_cache_lock;
+static GPtrArray *disas_cache;
+static unsigned disas_cache_flush_count;
+
+static const char *gen_disas_cache_insn(DisasContext *ctx, CPUState *cs)
+{
+    unsigned flush_count;
+    char *text;
+
+    if (!ctx->log_instr || !qemu_loglevel_mask(CPU_LOG_INSTR)) {
+        return NULL;
+    }
+    text = target_disas_str(cs, ctx->base.pc_next,
+                            (ctx->hflags & MIPS_HFLAG_M16) ? 2 : 4);
+
+    qemu_mutex_lock(&disas_cache_lock);
+    flush_count = atomic_read(&tb_ctx.tb_flush_count);
+    if (!disas_cache) {
+        disas_cache = g_ptr_array_new_with_free_func(g_free);
+    } else if (flush_count != disas_cache_flush_count) {
+        g_ptr_array_set_size(disas_cache, 0);
+    }
+    disas_cache_flush_count = flush_count;
+    g_ptr_array_add(disas_cache, text);
+    qemu_mutex_unlock(&disas_cache_lock);
+
+    return text;
+}
+#endif
+
 #include "translate_cheri.c"
 
 static inline void gen_op_addr_addi(DisasContext *ctx, TCGv ret, TCGv base,
@@ -4258,6 +4299,16 @@ static void gen_logic_imm(DisasContext *ctx, uint32_t opc,
             if ((uint16_t)imm == 0xface)
                 GEN_CHERI_TRACE_HELPER(cpu_env, cheri_debug_message);
 
+            /*
+             * Logging may have been switched on or off, which changes the
+             * TB flags.  Don't chain into a translation made for the old
+             * state; go through the TB lookup instead.
+             */
+            if ((uint16_t)imm == 0xbeef || (uint16_t)imm == 0xdead ||
+                (uint16_t)imm == 0xdeaf || (uint16_t)imm == 0xfaed) {
+                ctx->base.is_jmp = DISAS_STOP;
+            }
+
             /* With 0xcode invoke QEMU helper functions such as fast memset, memcpy etc.
              * They are designed to take the same register arguments as the libc function:
              * Currently supported values are:
@@ -4268,6 +4319,7 @@ static void gen_logic_imm(DisasContext *ctx, uint32_t opc,
              * $v1 = 5 -> memmove(dst=$a0, src=$a1, len=$a2)
              * $v1 = 6 -> purecap memmmove/memmove_c(dst=$c3, src=$c4, len=$a0)
              * $v1 = 7 -> bcopy(src=$a0, dst=$a1, len=$a2)
+             * $v1 = 9 -> purecap tag-preserving memmove(dst=$c3, src=$c4, len=$a0)
              * TODO: strlen? str{l,n}cpy?
              */
             if ((uint16_t)imm == 0xC0DE) {
@@ -30395,6 +30447,8 @@ static void mips_tr_init_disas_context(DisasContextBase *dcbase, CPUState *cs)
     ctx->cmgcr = (env->CP0_Config3 >> CP0C3_CMGCR) & 1;
     /* Restore delay slot state from the tb context.  */
     ctx->hflags = (uint32_t)ctx->base.tb->flags; /* FIXME: maybe use 64 bits? */
+    ctx->log_instr = ctx->hflags & MIPS_TBFLAG_LOG_INSTR;
+    ctx->hflags &= ~MIPS_TBFLAG_LOG_INSTR;
     ctx->ulri = (env->CP0_Config3 >> CP0C3_ULRI) & 1;
     ctx->ps = ((env->active_fpu.fcr0 >> FCR0_PS) & 1) ||
              (env->insn_flags & (INSN_LOONGSON2E | INSN_LOONGSON2F));
@@ -30419,8 +30473,92 @@ static void mips_tr_init_disas_context(DisasContextBase *dcbase, CPUState *cs)
               ctx->hflags);
 }
 
+#ifdef TARGET_CHERI
+/*
+ * AFL-compatible edge coverage (-afl-coverage). Each TB entry updates
+ * afl_area[cur_loc ^ prev_loc] inline, with the same location hash as AFL's
+ * own QEMU mode so that existing tooling can consume the bitmap.
+ */
+#define AFL_SHM_ENV_VAR "__AFL_SHM_ID"
+#define AFL_MAP_SIZE    (1 << 16)
+
+static uint8_t *afl_area_ptr;
+
+static void afl_coverage_init(void)
+{
+    const char *shm_id = getenv(AFL_SHM_ENV_VAR);
+
+    if (!afl_coverage_enabled) {
+        return;
+    }
+#ifdef CONFIG_POSIX
+    if (shm_id) {
+        afl_area_ptr = shmat(atoi(shm_id), NULL, 0);
+        if (afl_area_ptr == (void *)-1) {
+            error_report("afl-coverage: could not attach shared memory %s: %s",
+                         shm_id, strerror(errno));
+            exit(1);
+        }
+        return;
+    }
+#endif
+    warn_report("afl-coverage: %s not set, using a private bitmap",
+                AFL_SHM_ENV_VAR);
+    afl_area_ptr = g_malloc0(AFL_MAP_SIZE);
+}
+
+static void gen_afl_edge(DisasContext *ctx)
+{
+    target_ulong pc = ctx->base.pc_first;
+    uint32_t cur_loc = ((pc >> 4) ^ (pc << 8)) & (AFL_MAP_SIZE - 1);
+    TCGLabel *skip = NULL;
+    TCGv_i32 t0, t1;
+    TCGv_ptr p;
+
+    if (pc < afl_coverage_start || pc >= afl_coverage_end) {
+        return;
+    }
+    if (afl_coverage_asid >= 0) {
+        TCGv asid = tcg_temp_new();
+
+        skip = gen_new_label();
+        tcg_gen_ld_tl(asid, cpu_env, offsetof(CPUMIPSState, CP0_EntryHi));
+        tcg_gen_andi_tl(asid, asid, 0xFF);
+        tcg_gen_brcondi_tl(TCG_COND_NE, asid, afl_coverage_asid, skip);
+        tcg_temp_free(asid);
+    }
+
+    t0 = tcg_temp_new_i32();
+    t1 = tcg_temp_new_i32();
+    p = tcg_temp_new_ptr();
+    tcg_gen_ld_i32(t0, cpu_env, offsetof(CPUMIPSState, afl_prev_loc));
+    tcg_gen_xori_i32(t0, t0, cur_loc);
+    tcg_gen_ext_i32_ptr(p, t0);
+    tcg_gen_addi_ptr(p, p, (intptr_t)afl_area_ptr);
+    tcg_gen_ld8u_i32(t1, p, 0);
+    tcg_gen_addi_i32(t1, t1, 1);
+    tcg_gen_st8_i32(t1, p, 0);
+    tcg_gen_movi_i32(t0, cur_loc >> 1);
+    tcg_gen_st_i32(t0, cpu_env, offsetof(CPUMIPSState, afl_prev_loc));
+    tcg_temp_free_ptr(p);
+    tcg_temp_free_i32(t1);
+    tcg_temp_free_i32(t0);
+
+    if (skip) {
+        gen_set_label(skip);
+    }
+}
+#endif /* TARGET_CHERI */
+
 static void mips_tr_tb_start(DisasContextBase *dcbase, CPUState *cs)
 {
+#ifdef TARGET_CHERI
+    DisasContext *ctx = container_of(dcbase, DisasContext, base);
+
+    if (unlikely(afl_area_ptr)) {
+        gen_afl_edge(ctx);
+    }
+#endif
 }
 
 static void mips_tr_insn_start(DisasContextBase *dcbase, CPUState *cs)
@@ -30435,7 +30573,7 @@ static void mips_tr_insn_start(DisasContextBase *dcbase, CPUState *cs)
     tcg_gen_insn_start(ctx->base.pc_next, ctx->hflags & MIPS_HFLAG_BMASK,
                        ctx->btarget);
     /* Generate capabilities check on PC (and possibly log registers + instrs) */
-    GEN_CAP_CHECK_PC_AND_LOG_INSTR(ctx);
+    GEN_CAP_CHECK_PC_AND_LOG_INSTR(ctx, cs);
 }
 
 static bool mips_tr_breakpoint_check(DisasContextBase *dcbase, CPUState *cs,
@@ -30646,6 +30784,13 @@ void mips_tcg_init(void)
 {
     int i;
 
+#ifdef CONFIG_MIPS_LOG_INSTR
+    qemu_mutex_init(&disas_cache_lock);
+#endif
+#ifdef TARGET_CHERI
+    afl_coverage_init();
+#endif
+
     cpu_gpr[0] = NULL;
     for (i = 1; i < 32; i++)
         cpu_gpr[i] = tcg_global_mem_new(cpu_env,
@@ -948,15 +948,13 @@ static inline void generate_clbu(DisasContext *ctx, int32_t rd, int32_t cb,
     TCGv_i32 toffset = tcg_const_i32(cload_sign_extend(offset));
     TCGv t0 = tcg_temp_new();
     TCGv t1 = tcg_temp_new();
-    TCGv_i32 tlen = tcg_const_i32(1);
 
     gen_load_gpr(t1, rt);
-    gen_helper_cload(t0, cpu_env, tcb, t1, toffset, tlen);
+    gen_helper_cload1(t0, cpu_env, tcb, t1, toffset);
     tcg_gen_qemu_ld_tl(t1, t0, ctx->mem_idx, MO_UB);
     generate_dump_load(OPC_CLBU, t0, t1);
     gen_store_gpr(t1, rd);
 
-    tcg_temp_free_i32(tlen);
     tcg_temp_free(t1);
     tcg_temp_free(t0);
     tcg_temp_free_i32(toffset);
@@ -970,16 +968,14 @@ static inline void generate_clhu(DisasContext *ctx, int32_t rd, int32_t cb,
     TCGv_i32 toffset = tcg_const_i32(cload_sign_extend(offset) * 2);
     TCGv t0 = tcg_temp_new();
     TCGv t1 = tcg_temp_new();
-    TCGv_i32 tlen = tcg_const_i32(2);
 
     gen_load_gpr(t1, rt);
-    gen_helper_cload(t0, cpu_env, tcb, t1, toffset, tlen);
+    gen_helper_cload2(t0, cpu_env, tcb, t1, toffset);
     tcg_gen_qemu_ld_tl(t1, t0, ctx->mem_idx, MO_TEUW |
             ctx->default_tcg_memop_mask);
     generate_dump_load(OPC_CLHU, t0, t1);
     gen_store_gpr(t1, rd);
 
-    tcg_temp_free_i32(tlen);
     tcg_temp_free(t1);
     tcg_temp_free(t0);
     tcg_temp_free_i32(toffset);
@@ -993,16 +989,14 @@ static inline void generate_clwu(DisasContext *ctx, int32_t rd, int32_t cb,
     TCGv_i32 toffset = tcg_const_i32(cload_sign_extend(offset) * 4);
     TCGv t0 = tcg_temp_new();
     TCGv t1 = tcg_temp_new();
-    TCGv_i32 tlen = tcg_const_i32(4);
 
     gen_load_gpr(t1, rt);
-    gen_helper_cload(t0, cpu_env, tcb, t1, toffset, tlen);
+    gen_helper_cload4(t0, cpu_env, tcb, t1, toffset);
     tcg_gen_qemu_ld_tl(t1, t0, ctx->mem_idx, MO_TEUL |
             ctx->default_tcg_memop_mask);
     generate_dump_load(OPC_CLWU, t0, t1);
     gen_store_gpr(t1, rd);
 
-    tcg_temp_free_i32(tlen);
     tcg_temp_free(t1);
     tcg_temp_free(t0);
     tcg_temp_free_i32(toffset);
@@ -1016,15 +1010,13 @@ static inline void generate_clb(DisasContext *ctx, int32_t rd, int32_t cb,
     TCGv_i32 toffset = tcg_const_i32(cload_sign_extend(offset));
     TCGv t0 = tcg_temp_new();
     TCGv t1 = tcg_temp_new();
-    TCGv_i32 tlen = tcg_const_i32(1);
 
     gen_load_gpr(t1, rt);
-    gen_helper_cload(t0, cpu_env, tcb, t1, toffset, tlen);
+    gen_helper_cload1(t0, cpu_env, tcb, t1, toffset);
     tcg_gen_qemu_ld_tl(t1, t0, ctx->mem_idx, MO_SB);
     generate_dump_load(OPC_CLB, t0, t1);
     gen_store_gpr(t1, rd);
 
-    tcg_temp_free_i32(tlen);
     tcg_temp_free(t1);
     tcg_temp_free(t0);
     tcg_temp_free_i32(toffset);
@@ -1038,16 +1030,14 @@ static inline void generate_clh(DisasContext *ctx, int32_t rd, int32_t cb,
     TCGv_i32 toffset = tcg_const_i32(cload_sign_extend(offset) * 2);
     TCGv t0 = tcg_temp_new();
     TCGv t1 = tcg_temp_new();
-    TCGv_i32 tlen = tcg_const_i32(2);
 
     gen_load_gpr(t1, rt);
-    gen_helper_cload(t0, cpu_env, tcb, t1, toffset, tlen);
+    gen_helper_cload2(t0, cpu_env, tcb, t1, toffset);
     tcg_gen_qemu_ld_tl(t1, t0, ctx->mem_idx, MO_TESW |
             ctx->default_tcg_memop_mask);
     generate_dump_load(OPC_CLH, t0, t1);
     gen_store_gpr(t1, rd);
 
-    tcg_temp_free_i32(tlen);
     tcg_temp_free(t1);
     tcg_temp_free(t0);
     tcg_temp_free_i32(toffset);
@@ -1061,16 +1051,14 @@ static inline void generate_clw(DisasContext *ctx, int32_t rd, int32_t cb,
     TCGv_i32 toffset = tcg_const_i32(cload_sign_extend(offset) * 4);
     TCGv t0 = tcg_temp_new();
     TCGv t1 = tcg_temp_new();
-    TCGv_i32 tlen = tcg_const_i32(4);
 
     gen_load_gpr(t1, rt);
-    gen_helper_cload(t0, cpu_env, tcb, t1, toffset, tlen);
+    gen_helper_cload4(t0, cpu_env, tcb, t1, toffset);
     tcg_gen_qemu_ld_tl(t1, t0, ctx->mem_idx, MO_TESL |
             ctx->default_tcg_memop_mask);
     generate_dump_load(OPC_CLW, t0, t1);
     gen_store_gpr(t1, rd);
 
-    tcg_temp_free_i32(tlen);
     tcg_temp_free(t1);
     tcg_temp_free(t0);
     tcg_temp_free_i32(toffset);
@@ -1084,16 +1072,14 @@ static inline void generate_cld(DisasContext *ctx, int32_t rd, int32_t cb,
     TCGv_i32 toffset = tcg_const_i32(cload_sign_extend(offset) * 8);
     TCGv t0 = tcg_temp_new();
     TCGv t1 = tcg_temp_new();
-    TCGv_i32 tlen = tcg_const_i32(8);
 
     gen_load_gpr(t1, rt);
-    gen_helper_cload(t0, cpu_env, tcb, t1, toffset, tlen);
+    gen_helper_cload8(t0, cpu_env, tcb, t1, toffset);
     tcg_gen_qemu_ld_tl(t1, t0, ctx->mem_idx, MO_TEQ |
             ctx->default_tcg_memop_mask);
     generate_dump_load(OPC_CLD, t0, t1);
     gen_store_gpr(t1, rd);
 
-    tcg_temp_free_i32(tlen);
     tcg_temp_free(t1);
     tcg_temp_free(t0);
     tcg_temp_free_i32(toffset);
@@ -1384,11 +1370,24 @@ static inline void generate_cstore(TCGv taddr, TCGv trt, int32_t cb,
 {
     TCGv_i32 tcb = tcg_const_i32(cb);
     TCGv_i32 toffset = tcg_const_i32(cload_sign_extend(offset) * size);
-    TCGv_i32 tlen = tcg_const_i32(size);
 
-    gen_helper_cstore(taddr, cpu_env, tcb, trt, toffset, tlen);
+    switch (size) {
+    case 1:
+        gen_helper_cstore1(taddr, cpu_env, tcb, trt, toffset);
+        break;
+    case 2:
+        gen_helper_cstore2(taddr, cpu_env, tcb, trt, toffset);
+        break;
+    case 4:
+        gen_helper_cstore4(taddr, cpu_env, tcb, trt, toffset);
+        break;
+    case 8:
+        gen_helper_cstore8(taddr, cpu_env, tcb, trt, toffset);
+        break;
+    default:
+        g_assert_not_reached();
+    }
 
-    tcg_temp_free_i32(tlen);
     tcg_temp_free_i32(toffset);
     tcg_temp_free_i32(tcb);
 }
@@ -1546,14 +1545,20 @@ static inline void generate_cscc(DisasContext *ctx, int32_t cs, int32_t cb,
     tcg_temp_free(t0);
 }
 
-static inline void generate_ccheck_pc(DisasContext *ctx)
+static inline void generate_ccheck_pc(DisasContext *ctx, CPUState *cs)
 {
     TCGv_i64 tpc = tcg_const_i64(ctx->base.pc_next);
-    gen_helper_ccheck_pc(cpu_env, tpc);
+#ifdef CONFIG_MIPS_LOG_INSTR
+    TCGv_ptr tdisas = tcg_const_ptr(gen_disas_cache_insn(ctx, cs));
+#else
+    TCGv_ptr tdisas = tcg_const_ptr(NULL);
+#endif
+    gen_helper_ccheck_pc(cpu_env, tpc, tdisas);
+    tcg_temp_free_ptr(tdisas);
     tcg_temp_free_i64(tpc);
 }
 
-#define GEN_CAP_CHECK_PC_AND_LOG_INSTR(ctx)    generate_ccheck_pc(ctx)
+#define GEN_CAP_CHECK_PC_AND_LOG_INSTR(ctx, cs)    generate_ccheck_pc(ctx, cs)
 
 static inline void generate_ccheck_store(TCGv addr, TCGv offset, int32_t len)
 {
@@ -1669,18 +1674,24 @@ cp2_unimplemented:
 #else /* ! TARGET_CHERI */
 
 #ifdef CONFIG_MIPS_LOG_INSTR
-#define GEN_CAP_CHECK_PC_AND_LOG_INSTR(ctx) generate_dump_state_and_log_instr(ctx)
-static inline void generate_dump_state_and_log_instr(DisasContext *ctx)
+#define GEN_CAP_CHECK_PC_AND_LOG_INSTR(ctx, cs) generate_dump_state_and_log_instr(ctx, cs)
+static inline void generate_dump_state_and_log_instr(DisasContext *ctx,
+                                                     CPUState *cs)
 {
+    if (!ctx->log_instr) {
+        /* Logging was off when this TB was translated: emit nothing */
+        return;
+    }
     gen_helper_dump_changed_state(cpu_env);
     TCGv_i64 tpc = tcg_const_i64(ctx->base.pc_next);
-    gen_helper_log_instruction(cpu_env, tpc);
+    TCGv_ptr tdisas = tcg_const_ptr(gen_disas_cache_insn(ctx, cs));
+    gen_helper_log_instruction(cpu_env, tpc, tdisas);
+    tcg_temp_free_ptr(tdisas);
     tcg_temp_free_i64(tpc);
-
 }
 #else
 /* Do nothing */
-#define GEN_CAP_CHECK_PC_AND_LOG_INSTR(ctx)
+#define GEN_CAP_CHECK_PC_AND_LOG_INSTR(ctx, cs)
 #endif
 #define GEN_CAP_CHECK_STORE(addr, offset, len)
 #define GEN_CAP_CHECK_LOAD(save, addr, offset, len)
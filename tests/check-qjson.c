@@ -15,6 +15,7 @@
 
 #include "qapi/error.h"
 #include "qapi/qmp/qbool.h"
+#include "qapi/qmp/qdict.h"
 #include "qapi/qmp/qjson.h"
 #include "qapi/qmp/qlit.h"
 #include "qapi/qmp/qnull.h"
@@ -107,6 +108,55 @@ static void escaped_string(void)
     }
 }
 
+static void escaped_string_long_runs(void)
+{
+    static const struct {
+        const char *json;
+        const char *utf8;
+    } escapes[] = {
+        { "\\b\\f\\n\\r\\t\\\\\\\"", "\b\f\n\r\t\\\"" },
+        { "\\u00A2", "\xc2\xa2" },
+        { "\\uD834\\uDD1E", "\xF0\x9D\x84\x9E" },
+        { "100%", "100%" },
+    };
+    static const int run_len[] = { 1, 7, 4096 };
+    GString *json_in, *utf8_out;
+    QString *cstr;
+    char *jstr;
+    int i, j, k, n;
+
+    /*
+     * Escapes at the start, between and at the end of runs of plain
+     * ASCII, which both directions copy in one go
+     */
+    for (n = 0; n < ARRAY_SIZE(run_len); n++) {
+        json_in = g_string_new(NULL);
+        utf8_out = g_string_new(NULL);
+        for (i = 0; i < ARRAY_SIZE(escapes); i++) {
+            g_string_append(json_in, escapes[i].json);
+            g_string_append(utf8_out, escapes[i].utf8);
+            for (k = 0; k < run_len[n]; k++) {
+                g_string_append_c(json_in, 'a' + k % 26);
+                g_string_append_c(utf8_out, 'a' + k % 26);
+            }
+        }
+        g_string_append(json_in, escapes[0].json);
+        g_string_append(utf8_out, escapes[0].utf8);
+
+        for (j = 0; j < 2; j++) {
+            cstr = from_json_str(json_in->str, j, &error_abort);
+            g_assert_cmpstr(qstring_get_str(cstr), ==, utf8_out->str);
+            jstr = to_json_str(cstr);
+            g_assert_cmpstr(jstr, ==, json_in->str);
+            g_free(jstr);
+            qobject_unref(cstr);
+        }
+
+        g_string_free(json_in, true);
+        g_string_free(utf8_out, true);
+    }
+}
+
 static void string_with_quotes(void)
 {
     const char *test_cases[] = {
@@ -1052,6 +1102,41 @@ static void interpolation_string(void)
                               "can't interpolate into string*");
 }
 
+static void interpolation_percent(void)
+{
+    QObject *obj;
+    QDict *dict;
+
+    obj = qobject_from_jsonf_nofail("'%%'");
+    g_assert_cmpstr(qstring_get_str(qobject_to(QString, obj)), ==, "%");
+    qobject_unref(obj);
+
+    obj = qobject_from_jsonf_nofail("'%%%%'");
+    g_assert_cmpstr(qstring_get_str(qobject_to(QString, obj)), ==, "%%");
+    qobject_unref(obj);
+
+    /* %% amid runs of plain ASCII and escapes */
+    obj = qobject_from_jsonf_nofail(
+        "\"a fairly long run of plain text, then 100%% of %%d and %%s"
+        "\\n\\t%%\\\"%%u then another fairly long run of plain text%%\"");
+    g_assert_cmpstr(qstring_get_str(qobject_to(QString, obj)), ==,
+                    "a fairly long run of plain text, then 100% of %d and %s"
+                    "\n\t%\"%u then another fairly long run of plain text%");
+    qobject_unref(obj);
+
+    /* %% next to an actual interpolation */
+    dict = qdict_from_jsonf_nofail("{ 'key%%s': %d, '100%%': %s }",
+                                   42, "%%");
+    g_assert_cmpint(qdict_get_int(dict, "key%s"), ==, 42);
+    g_assert_cmpstr(qdict_get_str(dict, "100%"), ==, "%%");
+    qobject_unref(dict);
+
+    /* Without interpolation, %% is two percent signs */
+    obj = qobject_from_json("'100%%'", &error_abort);
+    g_assert_cmpstr(qstring_get_str(qobject_to(QString, obj)), ==, "100%%");
+    qobject_unref(obj);
+}
+
 static void simple_dict(void)
 {
     int i;
@@ -1468,6 +1553,8 @@ int main(int argc, char **argv)
     g_test_init(&argc, &argv, NULL);
 
     g_test_add_func("/literals/string/escaped", escaped_string);
+    g_test_add_func("/literals/string/escaped_long_runs",
+                    escaped_string_long_runs);
     g_test_add_func("/literals/string/quotes", string_with_quotes);
     g_test_add_func("/literals/string/utf8", utf8_string);
 
@@ -1480,6 +1567,7 @@ int main(int argc, char **argv)
     g_test_add_func("/literals/interpolation/valid", interpolation_valid);
     g_test_add_func("/literals/interpolation/unkown", interpolation_unknown);
     g_test_add_func("/literals/interpolation/string", interpolation_string);
+    g_test_add_func("/literals/interpolation/percent", interpolation_percent);
 
     g_test_add_func("/dicts/simple_dict", simple_dict);
     g_test_add_func("/dicts/large_dict", large_dict);
@@ -62,6 +62,19 @@ static void qstring_append_chr_test(void)
     qobject_unref(qstring);
 }
 
+static void qstring_append_len_test(void)
+{
+    QString *qstring;
+
+    qstring = qstring_from_str("qstring");
+    qstring_append_len(qstring, " append length unit-test", 7);
+    qstring_append_len(qstring, "", 0);
+
+    g_assert(strcmp(qstring_get_str(qstring), "qstring append") == 0);
+    g_assert(qstring_get_length(qstring) == 14);
+    qobject_unref(qstring);
+}
+
 static void qstring_from_substr_test(void)
 {
     QString *qs;
@@ -91,6 +104,7 @@ int main(int argc, char **argv)
     g_test_add_func("/public/from_str", qstring_from_str_test);
     g_test_add_func("/public/get_str", qstring_get_str_test);
     g_test_add_func("/public/append_chr", qstring_append_chr_test);
+    g_test_add_func("/public/append_len", qstring_append_len_test);
     g_test_add_func("/public/from_substr", qstring_from_substr_test);
     g_test_add_func("/public/to_qstring", qobject_to_qstring_test);
 
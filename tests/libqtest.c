@@ -238,9 +238,10 @@ QTestState *qtest_init_without_qmp_handshake(const char *extra_args)
                               "-mon chardev=char0,mode=control "
                               "-machine accel=qtest "
                               "-display none "
-                              "%s", qemu_binary, socket_path,
+                              "%s %s", qemu_binary, socket_path,
                               getenv("QTEST_LOG") ? "/dev/fd/2" : "/dev/null",
                               qmp_socket_path,
+                              getenv("QTEST_QEMU_ARGS") ?: "",
                               extra_args ?: "");
 
     g_test_message("starting QEMU: %s", command);
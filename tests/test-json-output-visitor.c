@@ -0,0 +1,253 @@
+/*
+ * JSON Output Visitor unit-tests.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+
+#include "qemu-common.h"
+#include "qapi/error.h"
+#include "qapi/json-output-visitor.h"
+#include "qapi/qobject-output-visitor.h"
+#include "test-qapi-visit.h"
+#include "qapi/qmp/qdict.h"
+#include "qapi/qmp/qjson.h"
+#include "qapi/qmp/qlist.h"
+#include "qapi/qmp/qnum.h"
+#include "qapi/qmp/qstring.h"
+
+typedef void (*VisitFunc)(Visitor *v, void *opaque);
+
+static QString *visit_to_json(VisitFunc visit, void *opaque,
+                              bool pretty, int indent)
+{
+    Visitor *v;
+    QString *json;
+
+    v = json_output_visitor_new(pretty, indent, &json);
+    visit(v, opaque);
+    visit_complete(v, &json);
+    visit_free(v);
+    g_assert(json);
+    return json;
+}
+
+static QObject *visit_to_qobject(VisitFunc visit, void *opaque)
+{
+    Visitor *v;
+    QObject *obj;
+
+    v = qobject_output_visitor_new(&obj);
+    visit(v, opaque);
+    visit_complete(v, &obj);
+    visit_free(v);
+    g_assert(obj);
+    return obj;
+}
+
+/*
+ * Check the JSON visitor writes what qobject_to_json() makes of the
+ * QObject visitor's result.  Compare text if member order can't
+ * differ, else compare the parsed text.
+ */
+static void check_visit(VisitFunc visit, void *opaque, bool same_text)
+{
+    QObject *obj = visit_to_qobject(visit, opaque);
+    QObject *parsed;
+    QString *json, *expected;
+    int pretty;
+
+    for (pretty = 0; pretty < 2; pretty++) {
+        json = visit_to_json(visit, opaque, pretty, 0);
+        if (same_text) {
+            expected = pretty ? qobject_to_json_pretty(obj)
+                              : qobject_to_json(obj);
+            g_assert_cmpstr(qstring_get_str(json), ==,
+                            qstring_get_str(expected));
+            qobject_unref(expected);
+        } else {
+            parsed = qobject_from_json(qstring_get_str(json), &error_abort);
+            g_assert(qobject_is_equal(parsed, obj));
+            qobject_unref(parsed);
+        }
+        qobject_unref(json);
+    }
+    qobject_unref(obj);
+}
+
+static void check_text(VisitFunc visit, void *opaque, const char *expected)
+{
+    QString *json = visit_to_json(visit, opaque, false, 0);
+
+    g_assert_cmpstr(qstring_get_str(json), ==, expected);
+    qobject_unref(json);
+}
+
+static void visit_int(Visitor *v, void *opaque)
+{
+    visit_type_int(v, NULL, opaque, &error_abort);
+}
+
+static void visit_uint64(Visitor *v, void *opaque)
+{
+    visit_type_uint64(v, NULL, opaque, &error_abort);
+}
+
+static void visit_bool(Visitor *v, void *opaque)
+{
+    visit_type_bool(v, NULL, opaque, &error_abort);
+}
+
+static void visit_number(Visitor *v, void *opaque)
+{
+    visit_type_number(v, NULL, opaque, &error_abort);
+}
+
+static void visit_str(Visitor *v, void *opaque)
+{
+    visit_type_str(v, NULL, opaque, &error_abort);
+}
+
+static void visit_null(Visitor *v, void *opaque)
+{
+    visit_type_null(v, NULL, opaque, &error_abort);
+}
+
+static void visit_any(Visitor *v, void *opaque)
+{
+    visit_type_any(v, NULL, opaque, &error_abort);
+}
+
+static void visit_intList(Visitor *v, void *opaque)
+{
+    visit_type_intList(v, NULL, opaque, &error_abort);
+}
+
+static void visit_UserDefOneList(Visitor *v, void *opaque)
+{
+    visit_type_UserDefOneList(v, NULL, opaque, &error_abort);
+}
+
+static void visit_UserDefTwo(Visitor *v, void *opaque)
+{
+    visit_type_UserDefTwo(v, NULL, opaque, &error_abort);
+}
+
+static void test_json_out_scalars(void)
+{
+    int64_t i = -42;
+    uint64_t u = UINT64_MAX;
+    bool b = true;
+    double d = 3.25;
+    char *s = (char *)"a \"quoted\"\n\xc2\xa2 string";
+    char *no_s = NULL;
+    QNull *null = NULL;
+
+    check_text(visit_int, &i, "-42");
+    check_text(visit_uint64, &u, "18446744073709551615");
+    check_text(visit_bool, &b, "true");
+    check_text(visit_str, &s, "\"a \\\"quoted\\\"\\n\\u00A2 string\"");
+    check_text(visit_str, &no_s, "\"\"");
+    check_text(visit_null, &null, "null");
+
+    check_visit(visit_int, &i, true);
+    check_visit(visit_uint64, &u, true);
+    check_visit(visit_number, &d, true);
+    check_visit(visit_str, &s, true);
+}
+
+static void test_json_out_list(void)
+{
+    intList *empty = NULL;
+    intList *head = NULL, *tail;
+    UserDefOneList *uhead = NULL, *utail;
+    QString *json;
+    int i;
+
+    check_visit(visit_intList, &empty, true);
+
+    for (i = 2; i >= 0; i--) {
+        tail = g_new0(intList, 1);
+        tail->value = i;
+        tail->next = head;
+        head = tail;
+
+        utail = g_new0(UserDefOneList, 1);
+        utail->value = g_new0(UserDefOne, 1);
+        utail->value->integer = i;
+        utail->value->string = g_strdup_printf("string%d", i);
+        utail->next = uhead;
+        uhead = utail;
+    }
+
+    check_text(visit_intList, &head, "[0, 1, 2]");
+    check_visit(visit_intList, &head, true);
+    check_visit(visit_UserDefOneList, &uhead, false);
+
+    /* Nested one level deep, as in a QMP response */
+    json = visit_to_json(visit_intList, &head, true, 1);
+    g_assert_cmpstr(qstring_get_str(json), ==,
+                    "[\n        0,\n        1,\n        2\n    ]");
+    qobject_unref(json);
+
+    qapi_free_intList(head);
+    qapi_free_UserDefOneList(uhead);
+}
+
+static void test_json_out_struct_nested(void)
+{
+    UserDefTwo *ud2;
+
+    ud2 = g_malloc0(sizeof(*ud2));
+    ud2->string0 = g_strdup("forty two");
+
+    ud2->dict1 = g_malloc0(sizeof(*ud2->dict1));
+    ud2->dict1->string1 = g_strdup("forty three");
+
+    ud2->dict1->dict2 = g_malloc0(sizeof(*ud2->dict1->dict2));
+    ud2->dict1->dict2->userdef = g_new0(UserDefOne, 1);
+    ud2->dict1->dict2->userdef->string = g_strdup("user def string");
+    ud2->dict1->dict2->userdef->integer = 42;
+    ud2->dict1->dict2->string = g_strdup("forty four");
+
+    check_visit(visit_UserDefTwo, &ud2, false);
+
+    qapi_free_UserDefTwo(ud2);
+}
+
+static void test_json_out_any(void)
+{
+    QDict *qdict = qdict_new();
+    QList *qlist = qlist_new();
+    QObject *qobj = QOBJECT(qdict);
+
+    qlist_append_int(qlist, 1);
+    qlist_append_str(qlist, "two");
+    qdict_put(qdict, "list", qlist);
+
+    /* A single member, so the text can't differ in member order */
+    check_visit(visit_any, &qobj, true);
+
+    qdict_put_bool(qdict, "boolean", true);
+    qdict_put_str(qdict, "string", "foo");
+    check_visit(visit_any, &qobj, false);
+
+    qobject_unref(qdict);
+}
+
+int main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/visitor/json-output/scalars", test_json_out_scalars);
+    g_test_add_func("/visitor/json-output/list", test_json_out_list);
+    g_test_add_func("/visitor/json-output/struct-nested",
+                    test_json_out_struct_nested);
+    g_test_add_func("/visitor/json-output/any", test_json_out_any);
+
+    g_test_run();
+
+    return 0;
+}
@@ -23,8 +23,10 @@
 #include "libqos/libqos.h"
 #include "libqos/pci-pc.h"
 #include "libqos/virtio-pci.h"
+#include "libqos/virtio-net.h"
 
 #include "libqos/malloc-pc.h"
+#include "hw/pci/pci_regs.h"
 #include "hw/virtio/virtio-net.h"
 
 #include "standard-headers/linux/vhost_types.h"
@@ -703,6 +705,40 @@ static void test_read_guest_mem(void *obj, void *arg, QGuestAllocator *alloc)
     read_guest_mem_server(global_qtest, server);
 }
 
+static void test_unrelated_commit(void *obj, void *arg,
+                                  QGuestAllocator *alloc)
+{
+    TestServer *server = arg;
+    QVirtioNetPCI *net = obj;
+    QPCIDevice *dev = net->pci_vdev.pdev;
+    uint16_t cmd;
+
+    if (!wait_for_fds(server)) {
+        return;
+    }
+
+    /*
+     * Toggling I/O decoding only changes the I/O address space, but it
+     * commits a memory transaction that vhost listens to.  The memory
+     * table sent to the backend must still cover guest RAM.
+     */
+    cmd = qpci_config_readw(dev, PCI_COMMAND);
+    qpci_config_writew(dev, PCI_COMMAND, cmd & ~PCI_COMMAND_IO);
+    qpci_config_writew(dev, PCI_COMMAND, cmd);
+
+    /*
+     * Stopping vhost waits for GET_VRING_BASE replies, so any memory
+     * table sent before has been processed once the reset returns.
+     */
+    qvirtio_reset(&net->pci_vdev.vdev);
+
+    g_mutex_lock(&server->data_mutex);
+    g_assert_cmpint(server->memory.nregions, >, 0);
+    g_mutex_unlock(&server->data_mutex);
+
+    read_guest_mem_server(global_qtest, server);
+}
+
 static void test_migrate(void *obj, void *arg, QGuestAllocator *alloc)
 {
     TestServer *s = arg;
@@ -938,6 +974,10 @@ static void register_vhost_user_test(void)
                      test_read_guest_mem, &opts);
     }
 
+    qos_add_test("vhost-user/unrelated-commit",
+                 "virtio-net-pci",
+                 test_unrelated_commit, &opts);
+
     qos_add_test("vhost-user/migrate",
                  "virtio-net",
                  test_migrate, &opts);
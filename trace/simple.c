@@ -29,9 +29,6 @@
 /** Records were dropped event ID */
 #define DROPPED_EVENT_ID (~(uint64_t)0 - 1)
 
-/** Trace record is valid */
-#define TRACE_RECORD_VALID ((uint64_t)1 << 63)
-
 /*
  * Trace records are written out by a dedicated thread.  The thread waits for
  * records to become available, writes them out, and then waits again.
@@ -44,13 +41,38 @@ static bool trace_available;
 static bool trace_writeout_enabled;
 
 enum {
-    TRACE_BUF_LEN = 4096 * 64,
+    TRACE_BUF_LEN = 4096 * 16,
     TRACE_BUF_FLUSH_THRESHOLD = TRACE_BUF_LEN / 4,
 };
 
-uint8_t trace_buf[TRACE_BUF_LEN];
-static volatile gint trace_idx;
-static unsigned int writeout_idx;
+QEMU_BUILD_BUG_ON(TRACE_BUF_LEN & (TRACE_BUF_LEN - 1));
+
+/*
+ * Each thread that emits events owns a ring buffer.  Only the owning
+ * thread advances head and only the writeout thread advances tail, so
+ * recording an event needs no atomic read-modify-write and threads never
+ * contend on a shared cache line.  Records are stored in the buffer
+ * exactly as they appear in the trace file, record type included, so the
+ * writeout thread can copy them out without parsing.
+ *
+ * Indexes are free-running and wrap at TRACE_BUF_LEN when dereferenced.
+ */
+typedef struct TraceThreadBuf {
+    struct TraceThreadBuf *next;   /* protected by trace_bufs_lock */
+    unsigned int head;             /* written by the owning thread */
+    unsigned int tail;             /* written by the writeout thread */
+    bool in_record;                /* owning thread is inside a record */
+    bool orphaned;                 /* owning thread has exited */
+    uint8_t data[TRACE_BUF_LEN];
+} TraceThreadBuf;
+
+static GMutex trace_bufs_lock;
+static TraceThreadBuf *trace_bufs;
+static __thread TraceThreadBuf *thread_buf;
+
+static void thread_buf_release(gpointer opaque);
+static GPrivate thread_buf_key = G_PRIVATE_INIT(thread_buf_release);
+
 static volatile gint dropped_events;
 static uint32_t trace_pid;
 static FILE *trace_fp;
@@ -75,55 +97,6 @@ typedef struct {
 } TraceLogHeader;
 
 
-static void read_from_buffer(unsigned int idx, void *dataptr, size_t size);
-static unsigned int write_to_buffer(unsigned int idx, void *dataptr, size_t size);
-
-static void clear_buffer_range(unsigned int idx, size_t len)
-{
-    uint32_t num = 0;
-    while (num < len) {
-        if (idx >= TRACE_BUF_LEN) {
-            idx = idx % TRACE_BUF_LEN;
-        }
-        trace_buf[idx++] = 0;
-        num++;
-    }
-}
-/**
- * Read a trace record from the trace buffer
- *
- * @idx         Trace buffer index
- * @record      Trace record to fill
- *
- * Returns false if the record is not valid.
- */
-static bool get_trace_record(unsigned int idx, TraceRecord **recordptr)
-{
-    uint64_t event_flag = 0;
-    TraceRecord record;
-    /* read the event flag to see if its a valid record */
-    read_from_buffer(idx, &record, sizeof(event_flag));
-
-    if (!(record.event & TRACE_RECORD_VALID)) {
-        return false;
-    }
-
-    smp_rmb(); /* read memory barrier before accessing record */
-    /* read the record header to know record length */
-    read_from_buffer(idx, &record, sizeof(TraceRecord));
-    *recordptr = malloc(record.length); /* don't use g_malloc, can deadlock when traced */
-    /* make a copy of record to avoid being overwritten */
-    read_from_buffer(idx, *recordptr, record.length);
-    smp_rmb(); /* memory barrier before clearing valid flag */
-    (*recordptr)->event &= ~TRACE_RECORD_VALID;
-    /* clear the trace buffer range for consumed record otherwise any byte
-     * with its MSB set may be considered as a valid event id when the writer
-     * thread crosses this range of buffer again.
-     */
-    clear_buffer_range(idx, record.length);
-    return true;
-}
-
 /**
  * Kick writeout thread
  *
@@ -153,14 +126,75 @@ static void wait_for_trace_records_available(void)
     g_mutex_unlock(&trace_lock);
 }
 
+/* Called on the owning thread when it exits */
+static void thread_buf_release(gpointer opaque)
+{
+    TraceThreadBuf *buf = opaque;
+
+    smp_wmb(); /* publish the last head update before orphaning */
+    atomic_set(&buf->orphaned, true);
+    thread_buf = NULL;
+}
+
+static TraceThreadBuf *thread_buf_get(void)
+{
+    TraceThreadBuf *buf = thread_buf;
+
+    if (likely(buf)) {
+        return buf;
+    }
+
+    buf = calloc(1, sizeof(*buf)); /* don't use g_malloc, can deadlock when traced */
+    if (!buf) {
+        return NULL;
+    }
+    g_private_set(&thread_buf_key, buf);
+
+    g_mutex_lock(&trace_bufs_lock);
+    buf->next = trace_bufs;
+    trace_bufs = buf;
+    g_mutex_unlock(&trace_bufs_lock);
+
+    thread_buf = buf;
+    return buf;
+}
+
+/**
+ * Write out everything a thread buffer holds
+ *
+ * Returns true if the buffer was orphaned and is now empty, in which case
+ * it can be freed.
+ */
+static bool writeout_thread_buf(TraceThreadBuf *buf)
+{
+    size_t unused __attribute__ ((unused));
+    bool orphaned = atomic_read(&buf->orphaned);
+    unsigned int head, tail, idx, len;
+
+    smp_rmb(); /* read orphaned before head, see thread_buf_release() */
+    head = atomic_read(&buf->head);
+    tail = buf->tail;
+    smp_rmb(); /* read head before the record data */
+
+    while (tail != head) {
+        idx = tail % TRACE_BUF_LEN;
+        len = MIN(head - tail, TRACE_BUF_LEN - idx);
+        unused = fwrite(&buf->data[idx], len, 1, trace_fp);
+        tail += len;
+    }
+
+    smp_mb(); /* finish reading the data before releasing the space */
+    atomic_set(&buf->tail, tail);
+    return orphaned;
+}
+
 static gpointer writeout_thread(gpointer opaque)
 {
-    TraceRecord *recordptr;
+    TraceThreadBuf *buf, **pprev;
     union {
         TraceRecord rec;
         uint8_t bytes[sizeof(TraceRecord) + sizeof(uint64_t)];
     } dropped;
-    unsigned int idx = 0;
     int dropped_count;
     size_t unused __attribute__ ((unused));
     uint64_t type = TRACE_RECORD_TYPE_EVENT;
@@ -182,99 +216,94 @@ static gpointer writeout_thread(gpointer opaque)
             unused = fwrite(&dropped.rec, dropped.rec.length, 1, trace_fp);
         }
 
-        while (get_trace_record(idx, &recordptr)) {
-            unused = fwrite(&type, sizeof(type), 1, trace_fp);
-            unused = fwrite(recordptr, recordptr->length, 1, trace_fp);
-            writeout_idx += recordptr->length;
-            free(recordptr); /* don't use g_free, can deadlock when traced */
-            idx = writeout_idx % TRACE_BUF_LEN;
+        g_mutex_lock(&trace_bufs_lock);
+        pprev = &trace_bufs;
+        while ((buf = *pprev) != NULL) {
+            if (writeout_thread_buf(buf)) {
+                *pprev = buf->next;
+                free(buf); /* don't use g_free, can deadlock when traced */
+            } else {
+                pprev = &buf->next;
+            }
         }
+        g_mutex_unlock(&trace_bufs_lock);
 
         fflush(trace_fp);
     }
     return NULL;
 }
 
+static unsigned int write_to_buffer(TraceThreadBuf *buf, unsigned int idx,
+                                    const void *dataptr, size_t size)
+{
+    const uint8_t *data_ptr = dataptr;
+    unsigned int off = idx % TRACE_BUF_LEN;
+    size_t len = MIN(size, TRACE_BUF_LEN - off);
+
+    memcpy(&buf->data[off], data_ptr, len);
+    memcpy(buf->data, data_ptr + len, size - len);
+    return idx + size; /* most callers wants to know where to write next */
+}
+
 void trace_record_write_u64(TraceBufferRecord *rec, uint64_t val)
 {
-    rec->rec_off = write_to_buffer(rec->rec_off, &val, sizeof(uint64_t));
+    rec->rec_off = write_to_buffer(thread_buf, rec->rec_off,
+                                   &val, sizeof(uint64_t));
 }
 
 void trace_record_write_str(TraceBufferRecord *rec, const char *s, uint32_t slen)
 {
     /* Write string length first */
-    rec->rec_off = write_to_buffer(rec->rec_off, &slen, sizeof(slen));
+    rec->rec_off = write_to_buffer(thread_buf, rec->rec_off,
+                                   &slen, sizeof(slen));
     /* Write actual string now */
-    rec->rec_off = write_to_buffer(rec->rec_off, (void*)s, slen);
+    rec->rec_off = write_to_buffer(thread_buf, rec->rec_off, s, slen);
 }
 
 int trace_record_start(TraceBufferRecord *rec, uint32_t event, size_t datasize)
 {
-    unsigned int idx, rec_off, old_idx, new_idx;
-    uint32_t rec_len = sizeof(TraceRecord) + datasize;
-    uint64_t event_u64 = event;
-    uint64_t timestamp_ns = get_clock();
-
-    do {
-        old_idx = g_atomic_int_get(&trace_idx);
-        smp_rmb();
-        new_idx = old_idx + rec_len;
-
-        if (new_idx - writeout_idx > TRACE_BUF_LEN) {
-            /* Trace Buffer Full, Event dropped ! */
-            g_atomic_int_inc(&dropped_events);
-            return -ENOSPC;
-        }
-    } while (!g_atomic_int_compare_and_exchange(&trace_idx, old_idx, new_idx));
-
-    idx = old_idx % TRACE_BUF_LEN;
-
-    rec_off = idx;
-    rec_off = write_to_buffer(rec_off, &event_u64, sizeof(event_u64));
-    rec_off = write_to_buffer(rec_off, &timestamp_ns, sizeof(timestamp_ns));
-    rec_off = write_to_buffer(rec_off, &rec_len, sizeof(rec_len));
-    rec_off = write_to_buffer(rec_off, &trace_pid, sizeof(trace_pid));
+    TraceThreadBuf *buf = thread_buf_get();
+    uint64_t type = TRACE_RECORD_TYPE_EVENT;
+    TraceRecord record = {
+        .event = event,
+        .timestamp_ns = get_clock(),
+        .length = sizeof(TraceRecord) + datasize,
+        .pid = trace_pid,
+    };
+    unsigned int idx;
+
+    if (!buf) {
+        g_atomic_int_inc(&dropped_events);
+        return -ENOMEM;
+    }
+    /* A signal handler tracing in the middle of a record would corrupt it */
+    if (buf->in_record ||
+        (buf->head - atomic_read(&buf->tail)) + sizeof(type) + record.length >
+        TRACE_BUF_LEN) {
+        /* Trace Buffer Full, Event dropped ! */
+        g_atomic_int_inc(&dropped_events);
+        return -ENOSPC;
+    }
+    buf->in_record = true;
 
-    rec->tbuf_idx = idx;
-    rec->rec_off  = (idx + sizeof(TraceRecord)) % TRACE_BUF_LEN;
+    rec->tbuf_idx = buf->head;
+    idx = write_to_buffer(buf, buf->head, &type, sizeof(type));
+    rec->rec_off = write_to_buffer(buf, idx, &record, sizeof(record));
     return 0;
 }
 
-static void read_from_buffer(unsigned int idx, void *dataptr, size_t size)
+void trace_record_finish(TraceBufferRecord *rec)
 {
-    uint8_t *data_ptr = dataptr;
-    uint32_t x = 0;
-    while (x < size) {
-        if (idx >= TRACE_BUF_LEN) {
-            idx = idx % TRACE_BUF_LEN;
-        }
-        data_ptr[x++] = trace_buf[idx++];
-    }
-}
+    TraceThreadBuf *buf = thread_buf;
+    unsigned int used;
 
-static unsigned int write_to_buffer(unsigned int idx, void *dataptr, size_t size)
-{
-    uint8_t *data_ptr = dataptr;
-    uint32_t x = 0;
-    while (x < size) {
-        if (idx >= TRACE_BUF_LEN) {
-            idx = idx % TRACE_BUF_LEN;
-        }
-        trace_buf[idx++] = data_ptr[x++];
-    }
-    return idx; /* most callers wants to know where to write next */
-}
+    smp_wmb(); /* write the record before publishing it */
+    atomic_set(&buf->head, rec->rec_off);
+    buf->in_record = false;
 
-void trace_record_finish(TraceBufferRecord *rec)
-{
-    TraceRecord record;
-    read_from_buffer(rec->tbuf_idx, &record, sizeof(TraceRecord));
-    smp_wmb(); /* write barrier before marking as valid */
-    record.event |= TRACE_RECORD_VALID;
-    write_to_buffer(rec->tbuf_idx, &record, sizeof(TraceRecord));
-
-    if (((unsigned int)g_atomic_int_get(&trace_idx) - writeout_idx)
-        > TRACE_BUF_FLUSH_THRESHOLD) {
+    used = rec->rec_off - atomic_read(&buf->tail);
+    if (used > TRACE_BUF_FLUSH_THRESHOLD &&
+        used - (rec->rec_off - rec->tbuf_idx) <= TRACE_BUF_FLUSH_THRESHOLD) {
         flush_trace_file(false);
     }
 }
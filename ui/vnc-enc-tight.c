@@ -678,8 +678,8 @@ check_solid_tile32(VncState *vs, int x, int y, int w, int h,
                    uint32_t *color, bool samecolor)
 {
     VncDisplay *vd = vs->vd;
-    uint32_t *fbptr;
-    uint32_t c;
+    uint32_t *fbptr, *row0;
+    uint32_t c, diff;
     int dx, dy;
 
     fbptr = vnc_server_fb_ptr(vd, x, y);
@@ -689,14 +689,26 @@ check_solid_tile32(VncState *vs, int x, int y, int w, int h,
         return false;
     }
 
-    for (dy = 0; dy < h; dy++) {
-        for (dx = 0; dx < w; dx++) {
-            if (c != fbptr[dx]) {
-                return false;
-            }
-        }
+    /*
+     * Check the first row without an early exit so the compiler can
+     * vectorize it, then compare the remaining rows against it with
+     * memcmp(), which the C library implements with SIMD.
+     */
+    diff = 0;
+    for (dx = 0; dx < w; dx++) {
+        diff |= fbptr[dx] ^ c;
+    }
+    if (diff) {
+        return false;
+    }
+
+    row0 = fbptr;
+    for (dy = 1; dy < h; dy++) {
         fbptr = (uint32_t *)
             ((uint8_t *)fbptr + vnc_server_fb_stride(vd));
+        if (memcmp(fbptr, row0, w * sizeof(uint32_t))) {
+            return false;
+        }
     }
 
     *color = (uint32_t)c;
@@ -200,6 +200,37 @@ int icount_align_option;
 #ifdef CONFIG_CHERI
 bool cheri_c2e_on_unrepresentable = false;
 bool cheri_debugger_on_unrepresentable = false;
+int cheri_verify_level = CONFIG_CHERI_VERIFY_LEVEL;
+const char *cheri_fault_log_file = NULL;
+bool cheri_fault_events = false;
+bool cheri_tag_reclaim_enabled = true;
+bool afl_coverage_enabled = false;
+int afl_coverage_asid = -1;
+uint64_t afl_coverage_start = 0;
+uint64_t afl_coverage_end = UINT64_MAX;
+
+static QemuOptsList qemu_afl_coverage_opts = {
+    .name = "afl-coverage",
+    .merge_lists = true,
+    .head = QTAILQ_HEAD_INITIALIZER(qemu_afl_coverage_opts.head),
+    .desc = {
+        {
+            .name = "asid",
+            .type = QEMU_OPT_NUMBER,
+        }, {
+            .name = "start",
+            .type = QEMU_OPT_NUMBER,
+        }, {
+            .name = "end",
+            .type = QEMU_OPT_NUMBER,
+        },
+        { /* end of list */ }
+    },
+};
+/* indexed by CHERI_VERIFY_* level */
+static const char *const cheri_verify_level_names[] = {
+    "off", "cheap", "paranoid",
+};
 #endif
 #ifdef CHERI_128
 #include "target/mips/cheri_utils.h"
@@ -3102,6 +3133,9 @@ int main(int argc, char **argv, char **envp)
     qemu_add_opts(&qemu_name_opts);
     qemu_add_opts(&qemu_numa_opts);
     qemu_add_opts(&qemu_icount_opts);
+#ifdef CONFIG_CHERI
+    qemu_add_opts(&qemu_afl_coverage_opts);
+#endif
     qemu_add_opts(&qemu_semihosting_config_opts);
     qemu_add_opts(&qemu_fw_cfg_opts);
     module_call_init(MODULE_INIT_OPTS);
@@ -3850,6 +3884,52 @@ int main(int argc, char **argv, char **envp)
             case QEMU_OPTION_cheri_debugger_on_unrepresentable:
                 cheri_debugger_on_unrepresentable = true;
                 break;
+            case QEMU_OPTION_cheri_verify_level:
+                for (i = 0; i < ARRAY_SIZE(cheri_verify_level_names); i++) {
+                    if (strcmp(optarg, cheri_verify_level_names[i]) == 0) {
+                        break;
+                    }
+                }
+                if (i == ARRAY_SIZE(cheri_verify_level_names)) {
+                    error_report("Invalid choice for cheri-verify-level: '%s'",
+                                 optarg);
+                    exit(1);
+                }
+                if (i > CONFIG_CHERI_VERIFY_LEVEL) {
+                    warn_report("cheri-verify-level %s is not compiled in, "
+                                "using %s", optarg,
+                                cheri_verify_level_names[CONFIG_CHERI_VERIFY_LEVEL]);
+                    i = CONFIG_CHERI_VERIFY_LEVEL;
+                }
+                cheri_verify_level = i;
+                break;
+            case QEMU_OPTION_cheri_fault_log:
+                cheri_fault_log_file = optarg;
+                break;
+            case QEMU_OPTION_cheri_fault_events:
+                cheri_fault_events = true;
+                break;
+            case QEMU_OPTION_cheri_no_tag_reclaim:
+                cheri_tag_reclaim_enabled = false;
+                break;
+            case QEMU_OPTION_afl_coverage:
+                opts = qemu_opts_parse_noisily(qemu_find_opts("afl-coverage"),
+                                               optarg, false);
+                if (!opts) {
+                    exit(1);
+                }
+                afl_coverage_enabled = true;
+                if (qemu_opt_get(opts, "asid")) {
+                    afl_coverage_asid = qemu_opt_get_number(opts, "asid", 0);
+                    if (afl_coverage_asid > 0xff) {
+                        error_report("afl-coverage: asid must be at most 255");
+                        exit(1);
+                    }
+                }
+                afl_coverage_start = qemu_opt_get_number(opts, "start", 0);
+                afl_coverage_end = qemu_opt_get_number(opts, "end",
+                                                       UINT64_MAX);
+                break;
 #endif /* CONFIG_CHERI */
             case QEMU_OPTION_icount:
                 icount_opts = qemu_opts_parse_noisily(qemu_find_opts("icount"),